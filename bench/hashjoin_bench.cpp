@@ -0,0 +1,404 @@
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <random>
+#include <tuple>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "hashjoin.h"
+
+namespace hashjoin {
+namespace {
+
+#ifdef BLOOM_FILTER_ENABLE
+const char* const kBloomLabel = "bloom";
+#else
+const char* const kBloomLabel = "no-bloom";
+#endif
+
+// Fixed seed so every run joins the same relations.
+constexpr uint64_t kSeed = 42;
+
+// Defaults for the dimensions a benchmark does not sweep.
+constexpr size_t kBuildSize = 1 << 18;
+constexpr size_t kProbeRatio = 4;
+constexpr int kZipfPercent = 0;
+constexpr int kSelectivityPercent = 100;
+constexpr int kThreads = 8;
+
+/**
+ * Reference cycles (TSC) on x86, nanoseconds elsewhere.
+ */
+inline auto read_cycles() -> uint64_t {
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+#endif
+}
+
+/**
+ * Draws ranks in [0, n) with P(rank) proportional to 1 / (rank + 1)^theta;
+ * theta 0 is uniform.
+ */
+class ZipfGenerator {
+ public:
+  ZipfGenerator(size_t n, double theta) : cdf_(n) {
+    double sum = 0;
+    for (size_t i = 0; i < n; ++i) {
+      sum += 1.0 / std::pow(static_cast<double>(i + 1), theta);
+      cdf_[i] = sum;
+    }
+    for (auto& c : cdf_) {
+      c /= sum;
+    }
+  }
+
+  template <typename Gen>
+  auto operator()(Gen& gen) -> size_t {
+    double u = std::uniform_real_distribution<double>(0, 1)(gen);
+    auto it = std::lower_bound(cdf_.begin(), cdf_.end(), u);
+    return std::min<size_t>(it - cdf_.begin(), cdf_.size() - 1);
+  }
+
+ private:
+  std::vector<double> cdf_;
+};
+
+struct Workload {
+  std::vector<std::pair<int, int>> R;
+  std::vector<std::pair<int, int>> S;
+};
+
+/**
+ * R draws keys from [1, build_size] with Zipf skew. A `selectivity_percent`
+ * share of S picks one of R's distinct keys uniformly, so it matches; the
+ * rest use keys above R's domain and match nothing. Keeping S unskewed
+ * stops hot keys from blowing the result up quadratically.
+ */
+auto make_workload(size_t build_size, size_t probe_ratio, int zipf_percent,
+                   int selectivity_percent) -> const Workload& {
+  static std::map<std::tuple<size_t, size_t, int, int>,
+                  std::unique_ptr<Workload>>
+      cache;
+  auto& slot = cache[std::make_tuple(build_size, probe_ratio, zipf_percent,
+                                     selectivity_percent)];
+  if (slot != nullptr) {
+    return *slot;
+  }
+  slot.reset(new Workload());
+  std::mt19937_64 gen(kSeed);
+  ZipfGenerator zipf(build_size, zipf_percent / 100.0);
+  // Shuffle ranks so that hot keys are not also the smallest keys.
+  std::vector<int> keys(build_size);
+  for (size_t i = 0; i < build_size; ++i) {
+    keys[i] = static_cast<int>(i + 1);
+  }
+  std::shuffle(keys.begin(), keys.end(), gen);
+
+  auto& R = slot->R;
+  R.reserve(build_size);
+  for (size_t i = 0; i < build_size; ++i) {
+    R.emplace_back(keys[zipf(gen)], static_cast<int>(i));
+  }
+  std::vector<int> distinct;
+  for (const auto& kv : R) {
+    distinct.push_back(kv.first);
+  }
+  std::sort(distinct.begin(), distinct.end());
+  distinct.erase(std::unique(distinct.begin(), distinct.end()),
+                 distinct.end());
+
+  auto& S = slot->S;
+  size_t probe_size = build_size * probe_ratio;
+  S.reserve(probe_size);
+  std::uniform_int_distribution<size_t> pick(0, distinct.size() - 1);
+  std::uniform_int_distribution<int> miss(static_cast<int>(build_size) + 1,
+                                          static_cast<int>(build_size) * 2);
+  std::uniform_int_distribution<int> percent(0, 99);
+  for (size_t i = 0; i < probe_size; ++i) {
+    int key = percent(gen) < selectivity_percent ? distinct[pick(gen)]
+                                                 : miss(gen);
+    S.emplace_back(key, static_cast<int>(i));
+  }
+  return *slot;
+}
+
+void run_join(benchmark::State& state, const Workload& w,
+              const JoinOptions& options) {
+  uint64_t cycles = 0;
+  size_t matches = 0;
+  for (auto _ : state) {
+    uint64_t start = read_cycles();
+    auto result = multi_threaded_hash_join(w.R, w.S, options);
+    cycles += read_cycles() - start;
+    matches = result.size();
+    benchmark::DoNotOptimize(result.data());
+  }
+  double tuples = static_cast<double>(w.R.size() + w.S.size());
+  state.counters["tuples/s"] =
+      benchmark::Counter(tuples, benchmark::Counter::kIsIterationInvariantRate);
+  state.counters["cycles/tuple"] =
+      static_cast<double>(cycles) / (tuples * state.iterations());
+  state.counters["matches"] = static_cast<double>(matches);
+  state.SetLabel(kBloomLabel);
+
+  // One more untimed run for hardware counters, when the PMU is readable.
+  JoinStats stats;
+  JoinOptions counted = options;
+  counted.stats = &stats;
+  counted.perf_counters = true;
+  multi_threaded_hash_join(w.R, w.S, counted);
+  PerfCounts counts = stats.partition.counters;
+  counts += stats.build.counters;
+  counts += stats.probe.counters;
+  counts += stats.merge.counters;
+  if (counts.available) {
+    state.counters["IPC"] =
+        counts.cycles == 0 ? 0
+                           : static_cast<double>(counts.instructions) /
+                                 counts.cycles;
+    state.counters["LLC-miss/tuple"] = counts.llc_misses / tuples;
+    state.counters["dTLB-miss/tuple"] = counts.dtlb_misses / tuples;
+    state.counters["br-miss/tuple"] = counts.branch_misses / tuples;
+  }
+}
+
+auto default_options(size_t build_size, int num_threads) -> JoinOptions {
+  JoinOptions options;
+  options.num_threads = num_threads;
+  options.table_size = build_size / 4 + 7;
+  options.key_size = build_size;
+  return options;
+}
+
+void BM_BuildSize(benchmark::State& state) {
+  size_t build_size = static_cast<size_t>(state.range(0));
+  run_join(state,
+           make_workload(build_size, kProbeRatio, kZipfPercent,
+                         kSelectivityPercent),
+           default_options(build_size, kThreads));
+}
+
+void BM_ProbeRatio(benchmark::State& state) {
+  run_join(state,
+           make_workload(kBuildSize, static_cast<size_t>(state.range(0)),
+                         kZipfPercent, kSelectivityPercent),
+           default_options(kBuildSize, kThreads));
+}
+
+// Zipf theta in percent: 99 is the classic "theta = 0.99" skew.
+void BM_Skew(benchmark::State& state) {
+  run_join(state,
+           make_workload(kBuildSize, kProbeRatio,
+                         static_cast<int>(state.range(0)),
+                         kSelectivityPercent),
+           default_options(kBuildSize, kThreads));
+}
+
+void BM_SkewAware(benchmark::State& state) {
+  auto options = default_options(kBuildSize, kThreads);
+  options.skew_aware = true;
+  run_join(state,
+           make_workload(kBuildSize, kProbeRatio,
+                         static_cast<int>(state.range(0)),
+                         kSelectivityPercent),
+           options);
+}
+
+void BM_Selectivity(benchmark::State& state) {
+  run_join(state,
+           make_workload(kBuildSize, kProbeRatio, kZipfPercent,
+                         static_cast<int>(state.range(0))),
+           default_options(kBuildSize, kThreads));
+}
+
+void BM_Threads(benchmark::State& state) {
+  run_join(state,
+           make_workload(kBuildSize, kProbeRatio, kZipfPercent,
+                         kSelectivityPercent),
+           default_options(kBuildSize, static_cast<int>(state.range(0))));
+}
+
+// Arg is a JoinAlgorithm value.
+void BM_Algorithm(benchmark::State& state) {
+  auto options = default_options(kBuildSize, kThreads);
+  options.algorithm = static_cast<JoinAlgorithm>(state.range(0));
+  run_join(state,
+           make_workload(kBuildSize, kProbeRatio, kZipfPercent,
+                         kSelectivityPercent),
+           options);
+}
+
+// Arg is a JoinType value; half of S misses so every variant emits rows.
+void BM_JoinType(benchmark::State& state) {
+  auto options = default_options(kBuildSize, kThreads);
+  options.join_type = static_cast<JoinType>(state.range(0));
+  run_join(state, make_workload(kBuildSize, kProbeRatio, kZipfPercent, 50),
+           options);
+}
+
+// Arg is whether the HashTable arenas ask for transparent huge pages.
+void BM_HugePages(benchmark::State& state) {
+  constexpr size_t kLargeBuild = 1 << 22;
+  auto options = default_options(kLargeBuild, kThreads);
+  options.huge_pages = state.range(0) != 0;
+  run_join(state,
+           make_workload(kLargeBuild, kProbeRatio, kZipfPercent,
+                         kSelectivityPercent),
+           options);
+}
+
+// Table sized for a hundredth of R, the guess the tests make; Arg is the
+// max_load_factor it grows by, 0 to keep that size.
+void BM_TableGrowth(benchmark::State& state) {
+  auto options = default_options(kBuildSize, kThreads);
+  options.table_size = kBuildSize / 100 + 7;
+  options.max_load_factor = static_cast<double>(state.range(0));
+  run_join(state,
+           make_workload(kBuildSize, kProbeRatio, kZipfPercent,
+                         kSelectivityPercent),
+           options);
+}
+
+// Probe of the default workload against a FrozenHashTable built once outside
+// the loop; BM_BuildSize builds the table in every iteration instead.
+void BM_FrozenProbe(benchmark::State& state) {
+  const auto& w = make_workload(kBuildSize, kProbeRatio, kZipfPercent,
+                                kSelectivityPercent);
+  auto options = default_options(kBuildSize, kThreads);
+  FrozenHashTable table(w.R, options);
+  size_t matches = 0;
+  for (auto _ : state) {
+    auto result = table.Probe(w.S, options);
+    matches = result.size();
+    benchmark::DoNotOptimize(result.data());
+  }
+  state.counters["tuples/s"] = benchmark::Counter(
+      static_cast<double>(w.S.size()),
+      benchmark::Counter::kIsIterationInvariantRate);
+  state.counters["matches"] = static_cast<double>(matches);
+}
+
+// COUNT/SUM over the default workload without materializing it; Arg is a
+// GroupBy value.
+void BM_JoinAggregate(benchmark::State& state) {
+  const auto& w = make_workload(kBuildSize, kProbeRatio, kZipfPercent,
+                                kSelectivityPercent);
+  auto options = default_options(kBuildSize, kThreads);
+  auto group_by = static_cast<GroupBy>(state.range(0));
+  uint64_t count = 0;
+  for (auto _ : state) {
+    auto result = join_aggregate(w.R, w.S, options, group_by);
+    count = 0;
+    for (const auto& row : result) {
+      count += row.count;
+    }
+    benchmark::DoNotOptimize(result.data());
+  }
+  state.counters["tuples/s"] = benchmark::Counter(
+      static_cast<double>(w.R.size() + w.S.size()),
+      benchmark::Counter::kIsIterationInvariantRate);
+  state.counters["matches"] = static_cast<double>(count);
+}
+
+// Args are the build size and whether the probe prefetches.
+void BM_Prefetch(benchmark::State& state) {
+  size_t build_size = static_cast<size_t>(state.range(0));
+  auto options = default_options(build_size, kThreads);
+  options.prefetch = state.range(1) != 0;
+  run_join(state,
+           make_workload(build_size, kProbeRatio, kZipfPercent,
+                         kSelectivityPercent),
+           options);
+}
+
+BENCHMARK(BM_BuildSize)
+    ->Arg(1 << 14)
+    ->Arg(1 << 16)
+    ->Arg(1 << 18)
+    ->Arg(1 << 20)
+    ->Arg(1 << 22)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK(BM_ProbeRatio)
+    ->Arg(1)
+    ->Arg(4)
+    ->Arg(16)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK(BM_Skew)
+    ->Arg(0)
+    ->Arg(50)
+    ->Arg(99)
+    ->Arg(150)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK(BM_SkewAware)
+    ->Arg(0)
+    ->Arg(50)
+    ->Arg(99)
+    ->Arg(150)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK(BM_Selectivity)
+    ->Arg(1)
+    ->Arg(10)
+    ->Arg(50)
+    ->Arg(100)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK(BM_Threads)
+    ->Arg(1)
+    ->Arg(2)
+    ->Arg(4)
+    ->Arg(8)
+    ->Arg(16)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK(BM_Algorithm)
+    ->DenseRange(static_cast<int>(JoinAlgorithm::kSharedHashTable),
+                 static_cast<int>(JoinAlgorithm::kGraceHashJoin))
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK(BM_Prefetch)
+    ->ArgsProduct({{1 << 16, 1 << 20, 1 << 22}, {0, 1}})
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK(BM_HugePages)
+    ->Arg(0)
+    ->Arg(1)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK(BM_TableGrowth)
+    ->Arg(0)
+    ->Arg(1)
+    ->Arg(4)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK(BM_FrozenProbe)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_JoinAggregate)
+    ->Arg(static_cast<int>(GroupBy::kNone))
+    ->Arg(static_cast<int>(GroupBy::kJoinKey))
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+BENCHMARK(BM_JoinType)
+    ->DenseRange(static_cast<int>(JoinType::kInner),
+                 static_cast<int>(JoinType::kRightOuter))
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+}  // namespace
+}  // namespace hashjoin
+
+BENCHMARK_MAIN();
@@ -1,5 +1,13 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
 #include <vector>
 #include <functional>
+#include <type_traits>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
 
 class BloomFilter {
 private:
@@ -36,3 +44,128 @@ public:
         return true;
     }
 };
+
+// Split block Bloom filter: a key maps to one 32-byte block and sets one bit
+// in each of its eight 32-bit words, so a lookup touches a single cache line
+// and is one AVX2 multiply/shift/test. insert() is safe to call from many
+// threads at once.
+class BlockedBloomFilter {
+private:
+    struct alignas(32) Block {
+        uint32_t words[8];
+    };
+
+    static constexpr uint32_t salt[8] = {0x47b6137bU, 0x44974d91U,
+                                         0x8824ad5bU, 0xa2b7289dU,
+                                         0x705495c7U, 0x2df1424bU,
+                                         0x9efc4947U, 0x5c6bfb31U};
+
+    std::vector<Block> blocks;
+    uint64_t block_mask = 0;
+    bool use_avx2 = false;
+
+    // The high half picks the block, the low half the bits inside it.
+    template <typename Key>
+    static uint64_t hash(Key key) {
+        static_assert(std::is_integral<Key>::value, "integer keys only");
+        uint64_t h = static_cast<typename std::make_unsigned<Key>::type>(key);
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    const Block& block_of(uint64_t h) const { return blocks[(h >> 32) & block_mask]; }
+
+    bool contains_scalar(uint64_t h) const {
+        const Block& block = block_of(h);
+        for (int i = 0; i < 8; ++i) {
+            uint32_t mask = 1u << ((static_cast<uint32_t>(h) * salt[i]) >> 27);
+            if ((block.words[i] & mask) == 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+#if defined(__x86_64__) || defined(__i386__)
+    __attribute__((target("avx2"))) bool contains_avx2(uint64_t h) const {
+        __m256i salts = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(salt));
+        __m256i product = _mm256_mullo_epi32(_mm256_set1_epi32(static_cast<int>(h)), salts);
+        __m256i mask = _mm256_sllv_epi32(_mm256_set1_epi32(1), _mm256_srli_epi32(product, 27));
+        __m256i block = _mm256_load_si256(reinterpret_cast<const __m256i*>(&block_of(h)));
+        return _mm256_testc_si256(block, mask);
+    }
+
+    __attribute__((target("avx2"))) size_t contains_batch_avx2(const int* keys, size_t n,
+                                                               uint32_t* sel) const {
+        size_t count = 0;
+        for (size_t i = 0; i < n; ++i) {
+            sel[count] = static_cast<uint32_t>(i);
+            count += contains_avx2(hash(keys[i]));
+        }
+        return count;
+    }
+#endif
+
+public:
+    BlockedBloomFilter() = default;
+    BlockedBloomFilter(size_t expected_keys, double target_fpr) {
+        // Bits per key for eight probes, ignoring the blocking overhead that
+        // the power-of-two rounding below makes up for.
+        double bits_per_key = -8.0 / std::log(1.0 - std::pow(target_fpr, 1.0 / 8));
+        size_t wanted = static_cast<size_t>(expected_keys * bits_per_key / 256) + 1;
+        size_t num_blocks = 1;
+        while (num_blocks < wanted) {
+            num_blocks <<= 1;
+        }
+        blocks.assign(num_blocks, Block{});
+        block_mask = num_blocks - 1;
+#if defined(__x86_64__) || defined(__i386__)
+        use_avx2 = __builtin_cpu_supports("avx2");
+#endif
+    }
+
+    template <typename Key>
+    void insert(Key key) {
+        uint64_t h = hash(key);
+        Block& block = blocks[(h >> 32) & block_mask];
+        for (int i = 0; i < 8; ++i) {
+            uint32_t mask = 1u << ((static_cast<uint32_t>(h) * salt[i]) >> 27);
+            // Skip the atomic RMW when the bit is already there.
+            if ((__atomic_load_n(&block.words[i], __ATOMIC_RELAXED) & mask) == 0) {
+                __atomic_fetch_or(&block.words[i], mask, __ATOMIC_RELAXED);
+            }
+        }
+    }
+
+    template <typename Key>
+    bool contains(Key key) const {
+#if defined(__x86_64__) || defined(__i386__)
+        if (use_avx2) {
+            return contains_avx2(hash(key));
+        }
+#endif
+        return contains_scalar(hash(key));
+    }
+
+    // Writes the indices of the keys that may be present into `sel` and
+    // returns how many there are.
+    size_t contains_batch(const int* keys, size_t n, uint32_t* sel) const {
+#if defined(__x86_64__) || defined(__i386__)
+        if (use_avx2) {
+            return contains_batch_avx2(keys, n, sel);
+        }
+#endif
+        size_t count = 0;
+        for (size_t i = 0; i < n; ++i) {
+            sel[count] = static_cast<uint32_t>(i);
+            count += contains_scalar(hash(keys[i]));
+        }
+        return count;
+    }
+
+    size_t size_in_bytes() const { return blocks.size() * sizeof(Block); }
+};
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "config.h"  // NOLINT
+#include "numa_util.h"
+
+namespace hashjoin {
+
+/**
+ * Bump allocator over chunks of anonymous memory. Allocate is a pointer
+ * bump and nothing is freed on its own; dropping the arena unmaps its few
+ * chunks. Chunks double from the first one's size up to ARENA_CHUNK_SIZE.
+ * Not thread-safe, see ArenaPool.
+ */
+class Arena {
+ public:
+  /**
+   * @param huge_pages Back the chunks with transparent huge pages.
+   * @param first_chunk Bytes of the first chunk, for an arena expected to
+   * hold little.
+   */
+  explicit Arena(bool huge_pages = false,
+                 size_t first_chunk = ARENA_CHUNK_SIZE)
+      : next_chunk_(first_chunk), huge_pages_(huge_pages) {}
+
+  auto Allocate(size_t bytes, size_t align) -> void* {
+    auto p = (reinterpret_cast<uintptr_t>(cursor_) + align - 1) &
+             ~static_cast<uintptr_t>(align - 1);
+    if (cursor_ == nullptr || p + bytes > reinterpret_cast<uintptr_t>(end_)) {
+      newChunk(bytes + align);
+      return Allocate(bytes, align);
+    }
+    used_ += p + bytes - reinterpret_cast<uintptr_t>(cursor_);
+    cursor_ = reinterpret_cast<char*>(p + bytes);
+    return reinterpret_cast<void*>(p);
+  }
+  template <typename T>
+  auto AllocateArray(size_t n) -> T* {
+    return static_cast<T*>(Allocate(n * sizeof(T), alignof(T)));
+  }
+  /**
+   * Grows the array `p` of `old_n` elements to `new_n`: in place when it is
+   * the arena's last allocation, else by copying it to a new one.
+   */
+  template <typename T>
+  auto GrowArray(T* p, size_t old_n, size_t new_n) -> T*;
+
+  auto bytes_reserved() const -> size_t { return reserved_; }
+  /**
+   * Bytes handed out, alignment padding included; the untouched tails of
+   * the chunks are not.
+   */
+  auto bytes_used() const -> size_t { return used_; }
+
+ private:
+  void newChunk(size_t min_bytes);
+
+  std::vector<NumaRegion> chunks_;
+  char* cursor_ = nullptr;
+  char* end_ = nullptr;
+  size_t reserved_ = 0;
+  size_t used_ = 0;
+  size_t next_chunk_;
+  bool huge_pages_;
+};
+
+/**
+ * One Arena per thread that allocates through the pool. Threads find theirs
+ * through a thread-local cache, so only a thread's first allocation (or its
+ * first after using another pool) takes the lock. Dropping the pool drops
+ * every arena.
+ */
+class ArenaPool {
+ public:
+  /**
+   * @param first_chunk Bytes of each arena's first chunk.
+   */
+  explicit ArenaPool(bool huge_pages = false,
+                     size_t first_chunk = ARENA_CHUNK_SIZE);
+  ArenaPool(const ArenaPool&) = delete;
+  auto operator=(const ArenaPool&) -> ArenaPool& = delete;
+
+  /**
+   * The calling thread's arena.
+   */
+  auto Local() -> Arena& {
+    if (cache_.pool_id != id_) {
+      cache_ = {id_, &lookup()};
+    }
+    return *cache_.arena;
+  }
+
+  auto bytes_reserved() const -> size_t;
+  auto bytes_used() const -> size_t;
+
+ private:
+  struct Cache {
+    uint64_t pool_id = 0;
+    Arena* arena = nullptr;
+  };
+  struct Owned {
+    std::thread::id owner;
+    std::unique_ptr<Arena> arena;
+  };
+
+  auto lookup() -> Arena&;
+
+  static thread_local Cache cache_;
+  // Unique across pools, so that a cache entry of a dropped pool never
+  // matches a new one at the same address.
+  const uint64_t id_;
+  const bool huge_pages_;
+  const size_t first_chunk_;
+  mutable std::mutex mtx_;
+  std::vector<Owned> arenas_;
+};
+
+template <typename T>
+auto Arena::GrowArray(T* p, size_t old_n, size_t new_n) -> T* {
+  auto* old_end = reinterpret_cast<char*>(p + old_n);
+  if (p != nullptr && old_end == cursor_ &&
+      reinterpret_cast<char*>(p + new_n) <= end_) {
+    cursor_ = reinterpret_cast<char*>(p + new_n);
+    used_ += (new_n - old_n) * sizeof(T);
+    return p;
+  }
+  T* grown = AllocateArray<T>(new_n);
+  std::copy(p, p + old_n, grown);
+  return grown;
+}
+
+};  // namespace hashjoin
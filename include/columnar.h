@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace hashjoin {
+
+/**
+ * A relation stored as separate key and payload columns. With `payloads`
+ * null, row ids stand in for payloads, so a join emits row-id pairs and only
+ * ever reads the key column.
+ */
+struct ColumnarRelation {
+  const int* keys = nullptr;
+  const int* payloads = nullptr;
+  size_t size = 0;
+
+  auto payload(size_t row) const -> int {
+    return payloads != nullptr ? payloads[row] : static_cast<int>(row);
+  }
+};
+
+/**
+ * Join result as two columns; row i is the match (r_values[i], s_values[i]).
+ */
+struct ColumnarResult {
+  std::vector<int> r_values;
+  std::vector<int> s_values;
+
+  auto size() const -> size_t { return r_values.size(); }
+};
+
+};  // namespace hashjoin
@@ -0,0 +1,225 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "config.h"  // NOLINT
+#include "join_stats.h"
+#include "probe_kernel.h"
+
+namespace hashjoin {
+
+/**
+ * Hash table with a lock-free Insert for the shared build phase. Every
+ * bucket is a 4-byte CAS-linked list head instead of a mutex plus vector,
+ * and each tuple takes one node from a pool sized up front, so concurrent
+ * builders only contend on the CAS of a shared bucket.
+ */
+class ConcurrentHashTable {
+ public:
+  /**
+   * @param capacity Max number of tuples the table will hold.
+   */
+  explicit ConcurrentHashTable(size_t capacity);
+  /**
+   * Thread-safe and lock-free. At most `capacity` tuples may be inserted.
+   * @throws std::length_error If the table already holds `capacity` tuples.
+   */
+  void Insert(int key, int value);
+  auto Get(int key) const -> std::vector<int>;
+  /**
+   * Calls `visit(value)` for every value stored under `key` without copying
+   * them out.
+   */
+  template <typename Visitor>
+  void ForEachMatch(int key, Visitor&& visit) const;
+  /**
+   * Calls `visit(value_r, value_s)` for every match of the `n` tuples at
+   * `kvs`. With prefetching on, heads and first nodes of PREFETCH_GROUP_SIZE
+   * keys are prefetched a stage ahead of the chain walks.
+   * @return The number of tuples with at least one match.
+   */
+  template <typename Visitor>
+  auto ProbeBatch(const std::pair<int, int>* kvs, size_t n,
+                  Visitor&& visit) const -> size_t;
+  /**
+   * Calls `visit(row, value_r)` for every match of keys[row], row in [0, n).
+   * @return The key counts; there is no prefilter, so every key passes.
+   */
+  template <typename Visitor>
+  auto ProbeKeys(const int* keys, size_t n, Visitor&& visit) const
+      -> ProbeCounts;
+  /**
+   * Turns group prefetching in ProbeBatch on (the default) or off.
+   */
+  void SetPrefetch(bool on) { prefetch_ = on; }
+  auto Build(std::vector<std::pair<int, int>>& kvs) -> void;
+
+  /**
+   * @param kvs The keys and values need to join.
+   * @return The matched (value_r, value_s) pairs.
+   */
+  auto Probe(std::vector<std::pair<int, int>>& kvs)
+      -> std::vector<std::pair<int, int>>;
+
+  auto size() const -> size_t { return num_nodes_.load(); }
+  /**
+   * @return result[i] is the number of buckets whose list has i tuples.
+   */
+  auto ChainLengthHistogram() const -> std::vector<size_t>;
+  auto size_in_bytes() const -> size_t {
+    return num_buckets_ * sizeof(heads_[0]) + capacity_ * sizeof(Node);
+  }
+
+ private:
+  static constexpr uint32_t kEnd = UINT32_MAX;
+
+  struct Node {
+    int key;
+    int value;
+    uint32_t next;
+  };
+
+  auto hash(int key) const -> size_t { return probe_hash(key, bits_); }
+
+  std::unique_ptr<std::atomic<uint32_t>[]> heads_;
+  size_t num_buckets_;
+  int bits_;
+  SimdLevel level_ = simd_level();
+  std::unique_ptr<Node[]> nodes_;
+  size_t capacity_;
+  std::atomic<size_t> num_nodes_{0};
+  bool prefetch_ = true;
+};
+
+template <typename Visitor>
+void ConcurrentHashTable::ForEachMatch(int key, Visitor&& visit) const {
+  for (uint32_t i = heads_[hash(key)].load(std::memory_order_acquire);
+       i != kEnd; i = nodes_[i].next) {
+    if (nodes_[i].key == key) {
+      visit(nodes_[i].value);
+    }
+  }
+}
+
+template <typename Visitor>
+auto ConcurrentHashTable::ProbeBatch(const std::pair<int, int>* kvs,
+                                     size_t n, Visitor&& visit) const
+    -> size_t {
+  size_t found = 0;
+  auto walk = [&](uint32_t i, const std::pair<int, int>& kv) {
+    bool hit = false;
+    for (; i != kEnd; i = nodes_[i].next) {
+      if (nodes_[i].key == kv.first) {
+        visit(nodes_[i].value, kv.second);
+        hit = true;
+      }
+    }
+    found += hit;
+  };
+  size_t group = prefetch_ ? PREFETCH_GROUP_SIZE : 1;
+  int keys[PREFETCH_GROUP_SIZE];
+  uint32_t heads[PREFETCH_GROUP_SIZE];
+  for (size_t base = 0; base < n; base += group) {
+    size_t len = std::min(group, n - base);
+    if (len == 1) {
+      walk(heads_[hash(kvs[base].first)].load(std::memory_order_acquire),
+           kvs[base]);
+      continue;
+    }
+    // Stage 1: hash the group in one go and prefetch the heads; stage 2:
+    // the first nodes; then walk.
+    for (size_t j = 0; j < len; ++j) {
+      keys[j] = kvs[base + j].first;
+    }
+    hash_keys(keys, len, bits_, heads, level_);
+    for (size_t j = 0; j < len; ++j) {
+      __builtin_prefetch(&heads_[heads[j]]);
+    }
+    for (size_t j = 0; j < len; ++j) {
+      heads[j] = heads_[heads[j]].load(std::memory_order_acquire);
+      if (heads[j] != kEnd) {
+        __builtin_prefetch(&nodes_[heads[j]]);
+      }
+    }
+    for (size_t j = 0; j < len; ++j) {
+      walk(heads[j], kvs[base + j]);
+    }
+  }
+  return found;
+}
+
+template <typename Visitor>
+auto ConcurrentHashTable::ProbeKeys(const int* keys, size_t n,
+                                    Visitor&& visit) const -> ProbeCounts {
+  ProbeCounts counts;
+  counts.probed = counts.passed = n;
+  for (size_t row = 0; row < n; ++row) {
+    bool matched = false;
+    ForEachMatch(keys[row], [&](int value_r) {
+      matched = true;
+      visit(row, value_r);
+    });
+    counts.found += matched;
+  }
+  return counts;
+}
+
+/**
+ * Lock-free set of keys for the semi and anti joins, which only ask whether
+ * a key exists. Open addressing over 4-byte key slots at most half full, so
+ * there are no payload lists or nodes to chase and a lookup stops at the
+ * first equal key or empty slot.
+ */
+class ConcurrentKeySet {
+ public:
+  /**
+   * @param capacity Max number of distinct keys the set will hold.
+   */
+  explicit ConcurrentKeySet(size_t capacity);
+  /**
+   * Thread-safe and lock-free; inserting a present key is a no-op.
+   */
+  void Insert(int key);
+  auto Contains(int key) const -> bool;
+  /**
+   * Writes the rows i in [0, n) whose keys[i] is in the set into `sel`, in
+   * order, with the find_keys kernel. Not to be called during Inserts.
+   * @return The number of rows written.
+   */
+  auto ContainsBatch(const int* keys, size_t n, uint32_t* sel) const
+      -> size_t;
+
+  auto size_in_bytes() const -> size_t { return (mask_ + 1) * sizeof(int); }
+
+ private:
+  // Marks an empty slot; the key itself is tracked in has_empty_key_.
+  static constexpr int kEmpty = INT32_MIN;
+
+  std::unique_ptr<std::atomic<int>[]> slots_;
+  size_t mask_;
+  int bits_;
+  std::atomic<bool> has_empty_key_{false};
+};
+
+inline auto ConcurrentKeySet::Contains(int key) const -> bool {
+  if (key == kEmpty) {
+    return has_empty_key_.load(std::memory_order_acquire);
+  }
+  for (size_t i = probe_hash(key, bits_);; i = (i + 1) & mask_) {
+    int slot = slots_[i].load(std::memory_order_acquire);
+    if (slot == key) {
+      return true;
+    }
+    if (slot == kEmpty) {
+      return false;
+    }
+  }
+}
+
+};  // namespace hashjoin
@@ -1,3 +1,35 @@
-#define TIME_ENABLE
 //#define BLOOM_FILTER_ENABLE
+// Keys checked against the Bloom filter per batch on the probe side.
+#define BLOOM_BATCH_SIZE 256
 
+// Per-core L2 size; the radix join sizes its partitions to fit in it.
+#define L2_CACHE_SIZE (256 * 1024)
+// Max radix bits split in one partition pass (keeps fanout TLB-friendly).
+#define MAX_RADIX_BITS_PER_PASS 8
+// Tuples per morsel handed out by the build/probe work-stealing scheduler.
+#define MORSEL_SIZE 16384
+// Pairs a join thread buffers before handing them to a ResultSink.
+#define SINK_BATCH_SIZE 4096
+// Tuples a Grace join reads back from a spill file at a time.
+#define SPILL_CHUNK_SIZE 65536
+// Tuples buffered per spill file before they are written out.
+#define SPILL_BUFFER_SIZE 4096
+// Resident S tuples a Grace join level gathers before probing them in one
+// parallel pass; fewer when the memory budget has no room for them.
+#define GRACE_PROBE_BATCH_SIZE (1 << 20)
+// R tuples the skew-aware join samples to find heavy-hitter keys.
+#define SKEW_SAMPLE_SIZE 4096
+// Sample hits that make a key heavy (8 of 4096 is about 0.2% of R).
+#define SKEW_MIN_SAMPLE_HITS 8
+// Probe keys whose lookups a group-prefetching probe keeps in flight.
+#define PREFETCH_GROUP_SIZE 16
+// Largest chunk a HashTable arena maps at a time per build thread; a
+// multiple of the 2 MiB huge page size.
+#define ARENA_CHUNK_SIZE (4 * 1024 * 1024)
+// Smallest first chunk of an arena, for tables expecting few keys.
+#define ARENA_MIN_CHUNK_SIZE (64 * 1024)
+// Probe keys a FrozenHashTable looks up per find_keys call.
+#define FROZEN_PROBE_BATCH_SIZE 64
+// Old buckets each HashTable Insert moves while a rehash is pending; a
+// doubling then ends before the keys grow by half the old bucket count.
+#define REHASH_BUCKETS_PER_INSERT 2
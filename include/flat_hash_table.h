@@ -0,0 +1,262 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "key_traits.h"
+
+namespace hashjoin {
+
+/**
+ * Slot of BasicFlatHashTable. A key seen once keeps its payload inline.
+ */
+template <typename Key, typename Value, typename = void>
+struct FlatSlot {
+  Key key;
+  uint32_t count;  // 0 marks an empty slot.
+  uint32_t head;   // Pool index if count > 1.
+  Value value;     // The payload if count == 1.
+
+  auto inline_value() const -> Value { return value; }
+  void set_inline_value(const Value& v) { value = v; }
+};
+
+/**
+ * Packed slot for payloads of at most 32 bits: the inline payload shares the
+ * pool-index field, so an int64 key with an int payload takes 16 bytes.
+ */
+template <typename Key, typename Value>
+struct FlatSlot<Key, Value,
+                typename std::enable_if<std::is_integral<Value>::value &&
+                                        sizeof(Value) <= sizeof(uint32_t)>::type> {
+  Key key;
+  uint32_t count;  // 0 marks an empty slot.
+  uint32_t head;   // The payload itself if count == 1, else a pool index.
+
+  auto inline_value() const -> Value { return static_cast<Value>(head); }
+  void set_inline_value(Value v) { head = static_cast<uint32_t>(v); }
+};
+
+/**
+ * Open-addressing hash table with the same Insert/Get/Build/Probe interface
+ * as HashTable. Slots are packed in one power-of-two array and probed
+ * linearly; a key seen once keeps its payload inline in the slot, duplicates
+ * live in one shared payload pool instead of per-key vectors. Not
+ * thread-safe.
+ * @tparam Traits Hash policy, see KeyTraits.
+ */
+template <typename Key, typename Value, typename Traits = KeyTraits<Key>>
+class BasicFlatHashTable {
+ public:
+  using KeyValue = std::pair<Key, Value>;
+
+  explicit BasicFlatHashTable(size_t expected_keys = 10007) {
+    reserve(expected_keys);
+  }
+  void Insert(const Key& key, const Value& value);
+  auto Get(const Key& key) const -> std::vector<Value>;
+  /**
+   * Calls `visit(value)` for every value stored under `key` without copying
+   * them out.
+   */
+  template <typename Visitor>
+  void ForEachMatch(const Key& key, Visitor&& visit) const;
+  /**
+   * On an empty table, lays every key's payloads out as one contiguous run.
+   */
+  auto Build(std::vector<KeyValue>& kvs) -> void;
+
+  /**
+   * @param kvs The keys and values need to join.
+   * @return The matched (value_r, value_s) pairs.
+   */
+  auto Probe(std::vector<KeyValue>& kvs)
+      -> std::vector<std::pair<Value, Value>>;
+
+  auto size() const -> size_t { return num_keys_; }
+  auto capacity() const -> size_t { return slots_.size(); }
+
+ private:
+  static constexpr uint32_t kEnd = UINT32_MAX;
+
+  using Slot = FlatSlot<Key, Value>;
+  struct PayloadNode {
+    Value value;
+    uint32_t next;
+  };
+
+  auto hash(const Key& key) const -> size_t {
+    // The top bits of the hash index the table, so no modulo is needed.
+    return static_cast<size_t>(Traits::hash(key) >> shift_);
+  }
+  auto findSlot(const Key& key) const -> size_t;
+  void grow() { reserve(slots_.size()); }
+  void reserve(size_t num_keys);
+
+  std::vector<Slot> slots_;
+  std::vector<PayloadNode> payloads_;
+  size_t num_keys_ = 0;
+  int shift_ = 64;
+};
+
+using FlatHashTable = BasicFlatHashTable<int, int>;
+
+//-----------public--------------
+template <typename Key, typename Value, typename Traits>
+void BasicFlatHashTable<Key, Value, Traits>::Insert(const Key& key,
+                                                    const Value& value) {
+  if ((num_keys_ + 1) * 2 > slots_.size()) {
+    grow();
+  }
+  auto& slot = slots_[findSlot(key)];
+  if (slot.count == 0) {
+    slot.key = key;
+    slot.count = 1;
+    slot.set_inline_value(value);
+    ++num_keys_;
+    return;
+  }
+  if (slot.count == 1) {
+    // Second payload: move the inline one into the pool first.
+    payloads_.push_back({slot.inline_value(), kEnd});
+    slot.head = static_cast<uint32_t>(payloads_.size() - 1);
+  }
+  payloads_.push_back({value, slot.head});
+  slot.head = static_cast<uint32_t>(payloads_.size() - 1);
+  ++slot.count;
+}
+
+template <typename Key, typename Value, typename Traits>
+auto BasicFlatHashTable<Key, Value, Traits>::Get(const Key& key) const
+    -> std::vector<Value> {
+  std::vector<Value> values;
+  const auto& slot = slots_[findSlot(key)];
+  values.reserve(slot.count);
+  ForEachMatch(key, [&](const Value& value) { values.push_back(value); });
+  return values;
+}
+
+template <typename Key, typename Value, typename Traits>
+template <typename Visitor>
+void BasicFlatHashTable<Key, Value, Traits>::ForEachMatch(
+    const Key& key, Visitor&& visit) const {
+  const auto& slot = slots_[findSlot(key)];
+  if (slot.count == 1) {
+    visit(slot.inline_value());
+  } else if (slot.count > 1) {
+    for (uint32_t i = slot.head; i != kEnd; i = payloads_[i].next) {
+      visit(payloads_[i].value);
+    }
+  }
+}
+
+//-----------build---------------
+
+template <typename Key, typename Value, typename Traits>
+void BasicFlatHashTable<Key, Value, Traits>::Build(
+    std::vector<KeyValue>& kvs) {
+  if (num_keys_ != 0) {
+    for (auto& kv : kvs) {
+      Insert(kv.first, kv.second);
+    }
+    return;
+  }
+  // Pass 1: claim a slot per distinct key and count its payloads.
+  for (auto& kv : kvs) {
+    if ((num_keys_ + 1) * 2 > slots_.size()) {
+      grow();
+    }
+    auto& slot = slots_[findSlot(kv.first)];
+    if (slot.count == 0) {
+      slot.key = kv.first;
+      ++num_keys_;
+    }
+    ++slot.count;
+  }
+  // Give every duplicated key a contiguous run; head is its end cursor.
+  size_t total = 0;
+  for (auto& slot : slots_) {
+    if (slot.count > 1) {
+      total += slot.count;
+      slot.head = static_cast<uint32_t>(total);
+    }
+  }
+  payloads_.resize(total);
+  for (size_t i = 0; i < total; ++i) {
+    payloads_[i].next = static_cast<uint32_t>(i + 1);
+  }
+  for (auto& slot : slots_) {
+    if (slot.count > 1) {
+      payloads_[slot.head - 1].next = kEnd;
+    }
+  }
+  // Pass 2: fill runs back to front, which leaves head at the run start.
+  for (auto& kv : kvs) {
+    auto& slot = slots_[findSlot(kv.first)];
+    if (slot.count == 1) {
+      slot.set_inline_value(kv.second);
+    } else {
+      payloads_[--slot.head].value = kv.second;
+    }
+  }
+}
+
+//-----------probe---------------
+
+template <typename Key, typename Value, typename Traits>
+auto BasicFlatHashTable<Key, Value, Traits>::Probe(std::vector<KeyValue>& kvs)
+    -> std::vector<std::pair<Value, Value>> {
+  std::vector<std::pair<Value, Value>> result;
+  for (auto& kv : kvs) {
+    ForEachMatch(kv.first, [&](const Value& value_r) {
+      result.push_back({value_r, kv.second});
+    });
+  }
+  return result;
+}
+
+//-----------utils---------------
+template <typename Key, typename Value, typename Traits>
+auto BasicFlatHashTable<Key, Value, Traits>::findSlot(const Key& key) const
+    -> size_t {
+  size_t mask = slots_.size() - 1;
+  size_t i = hash(key);
+  while (slots_[i].count != 0 && !Traits::equal(slots_[i].key, key)) {
+    i = (i + 1) & mask;
+  }
+  return i;
+}
+
+template <typename Key, typename Value, typename Traits>
+void BasicFlatHashTable<Key, Value, Traits>::reserve(size_t num_keys) {
+  // Keep the load factor at or below 1/2.
+  size_t capacity = 16;
+  int shift = 60;
+  while (capacity < num_keys * 2) {
+    capacity <<= 1;
+    --shift;
+  }
+  if (capacity <= slots_.size()) {
+    return;
+  }
+  std::vector<Slot> old(capacity, Slot{});
+  old.swap(slots_);
+  shift_ = shift;
+  size_t mask = capacity - 1;
+  for (const auto& slot : old) {
+    if (slot.count != 0) {
+      size_t i = hash(slot.key);
+      while (slots_[i].count != 0) {
+        i = (i + 1) & mask;
+      }
+      slots_[i] = slot;
+    }
+  }
+}
+
+extern template class BasicFlatHashTable<int, int>;
+
+};  // namespace hashjoin
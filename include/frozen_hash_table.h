@@ -0,0 +1,162 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "config.h"  // NOLINT
+#include "join_options.h"
+#include "probe_kernel.h"
+
+namespace hashjoin {
+
+/**
+ * Read-only hash table of R that is built once and then probed by any
+ * number of joins. The parallel build freezes R into three flat arrays:
+ * distinct keys in open-addressing slots at most half full, one
+ * {begin, count} range per slot, and the payloads of each key stored
+ * contiguously in a range. A lookup is a run of key compares in one array
+ * followed by a sequential read of payloads, with no locks, chains or
+ * per-key allocations. Nothing changes after construction, so concurrent
+ * probes from different threads need no synchronization.
+ */
+class FrozenHashTable {
+ public:
+  /**
+   * Builds the table with join_threads(options) threads; fills the build
+   * phase of options.stats when set.
+   */
+  FrozenHashTable(const std::vector<std::pair<int, int>>& R,
+                  const JoinOptions& options);
+
+  /**
+   * Calls `visit(value)` for every value stored under `key`.
+   */
+  template <typename Visitor>
+  void ForEachMatch(int key, Visitor&& visit) const;
+  /**
+   * Calls `visit(value_r, value_s)` for every match of the `n` tuples at
+   * `kvs`. FROZEN_PROBE_BATCH_SIZE keys at a time are located with the
+   * find_keys kernel, and their ranges and payloads are prefetched before
+   * they are read unless `prefetch` is off.
+   * @return The number of tuples with at least one match.
+   */
+  template <typename Visitor>
+  auto ProbeBatch(const std::pair<int, int>* kvs, size_t n, Visitor&& visit,
+                  bool prefetch = true) const -> size_t;
+  /**
+   * Inner join of S against the table with join_threads(options) threads.
+   * Honors options.sink and options.prefetch and fills the probe phase of
+   * options.stats, leaving its build phase to the constructor's stats.
+   * @return The matched (value_r, value_s) pairs.
+   */
+  auto Probe(const std::vector<std::pair<int, int>>& S,
+             const JoinOptions& options) const
+      -> std::vector<std::pair<int, int>>;
+
+  auto size() const -> size_t { return num_values_; }
+  auto num_keys() const -> size_t { return num_keys_; }
+  auto size_in_bytes() const -> size_t {
+    return num_slots_ * sizeof(int) + (num_slots_ + 1) * sizeof(Range) +
+           num_values_ * sizeof(int);
+  }
+
+ private:
+  // Marks an empty slot; the key itself gets range num_slots_.
+  static constexpr int kEmpty = INT32_MIN;
+
+  struct Range {
+    uint32_t begin;
+    uint32_t count;
+  };
+
+  /**
+   * @return The range of `key`, or null when it is absent.
+   */
+  auto find(int key) const -> const Range*;
+  auto insertKey(int key) -> size_t;
+
+  std::unique_ptr<int[]> keys_;
+  std::unique_ptr<Range[]> ranges_;
+  std::unique_ptr<int[]> values_;
+  size_t num_slots_;
+  size_t mask_;
+  int bits_;
+  size_t num_keys_ = 0;
+  size_t num_values_;
+  SimdLevel level_ = simd_level();
+};
+
+inline auto FrozenHashTable::find(int key) const -> const Range* {
+  if (key == kEmpty) {
+    return &ranges_[num_slots_];
+  }
+  for (size_t i = probe_hash(key, bits_);; i = (i + 1) & mask_) {
+    if (keys_[i] == key) {
+      return &ranges_[i];
+    }
+    if (keys_[i] == kEmpty) {
+      return nullptr;
+    }
+  }
+}
+
+template <typename Visitor>
+void FrozenHashTable::ForEachMatch(int key, Visitor&& visit) const {
+  if (const Range* range = find(key)) {
+    for (uint32_t i = range->begin; i < range->begin + range->count; ++i) {
+      visit(values_[i]);
+    }
+  }
+}
+
+template <typename Visitor>
+auto FrozenHashTable::ProbeBatch(const std::pair<int, int>* kvs, size_t n,
+                                 Visitor&& visit, bool prefetch) const
+    -> size_t {
+  size_t found = 0;
+  bool has_empty_key = ranges_[num_slots_].count > 0;
+  int keys[FROZEN_PROBE_BATCH_SIZE];
+  uint32_t sel[FROZEN_PROBE_BATCH_SIZE];
+  uint32_t slots[FROZEN_PROBE_BATCH_SIZE];
+  for (size_t base = 0; base < n; base += FROZEN_PROBE_BATCH_SIZE) {
+    size_t len = std::min<size_t>(FROZEN_PROBE_BATCH_SIZE, n - base);
+    for (size_t j = 0; j < len; ++j) {
+      keys[j] = kvs[base + j].first;
+    }
+    size_t hits = find_keys(keys_.get(), bits_, kEmpty, keys, len, sel, slots,
+                            level_);
+    if (prefetch) {
+      for (size_t j = 0; j < hits; ++j) {
+        __builtin_prefetch(&ranges_[slots[j]]);
+      }
+      for (size_t j = 0; j < hits; ++j) {
+        __builtin_prefetch(&values_[ranges_[slots[j]].begin]);
+      }
+    }
+    for (size_t j = 0; j < hits; ++j) {
+      const Range& range = ranges_[slots[j]];
+      int value_s = kvs[base + sel[j]].second;
+      for (uint32_t i = range.begin; i < range.begin + range.count; ++i) {
+        visit(values_[i], value_s);
+      }
+    }
+    found += hits;
+    // The kernel never finds the marker key.
+    if (has_empty_key) {
+      for (size_t j = 0; j < len; ++j) {
+        if (keys[j] == kEmpty) {
+          int value_s = kvs[base + j].second;
+          ForEachMatch(kEmpty, [&](int value_r) { visit(value_r, value_s); });
+          ++found;
+        }
+      }
+    }
+  }
+  return found;
+}
+
+};  // namespace hashjoin
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "join_options.h"
+
+namespace hashjoin {
+
+/**
+ * What a Grace join wrote to disk.
+ */
+struct GraceStats {
+  size_t spilled_partitions = 0;
+  size_t spilled_tuples = 0;  // R and S tuples written to spill files.
+  int max_depth = 0;          // Deepest repartitioning level reached.
+};
+
+/**
+ * Memory-bounded hybrid hash join. R is hash-partitioned and partitions stay
+ * in memory while they fit `options.memory_budget`; the largest resident
+ * partition is spilled to a temp file whenever the budget is exceeded. The
+ * resident partitions go into one HashTable that S is probed against while
+ * it is partitioned, and spilled partition pairs are then joined the same
+ * way one level down, with fresh hash bits. A partition that cannot be
+ * split further (one key) is joined in memory regardless of the budget.
+ * @return The matched (value_r, value_s) pairs.
+ */
+auto grace_hash_join(const std::vector<std::pair<int, int>>& R,
+                     const std::vector<std::pair<int, int>>& S,
+                     const JoinOptions& options)
+    -> std::vector<std::pair<int, int>>;
+
+};  // namespace hashjoin
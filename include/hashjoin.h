@@ -1,35 +1,113 @@
+#pragma once
+
+#include <atomic>
 #include <iostream>
+#include <memory>
 #include <mutex>
 #include <thread>
 #include <vector>
+#include <algorithm>
 #include <cmath>
 
 #include "MyBloom_filter.hpp"
+#include "arena.h"
+#include "columnar.h"
+#include "concurrent_hash_table.h"
 #include "config.h"  // NOLINT
-#ifdef TIME_ENABLE
-#include <chrono>
-#endif
+#include "frozen_hash_table.h"
+#include "grace_hash_join.h"
+#include "join_aggregate.h"
+#include "join_options.h"
+#include "join_stats.h"
+#include "join_variants.h"
+#include "morsel_scheduler.h"
+#include "numa_util.h"
+#include "probe_kernel.h"
+#include "relation_file.h"
+#include "result_sink.h"
+#include "skew_join.h"
+#include "sort_merge_join.h"
+#include "thread_pool.h"
+#include "typed_join.h"
 
 namespace hashjoin {
 
 class HashTable {
  public:
+  /**
+   * @param num_buckets Rounded up to a power of two, so that a multiplicative
+   * hash can pick the bucket without a division.
+   * @param key_size Expected keys; also sizes the arenas' first chunks.
+   * @param huge_pages Back the arenas with transparent huge pages.
+   */
   explicit HashTable(size_t num_buckets = 10007, size_t key_size = 10000,
-                     double target_fpr = 0.01)
-      : buckets(num_buckets) {
+                     double target_fpr = 0.01, bool huge_pages = false)
+      : arena_(huge_pages, first_chunk(key_size)) {
+    arrays_.emplace_back(new BucketArray(bucket_bits(num_buckets)));
+    current_.store(arrays_.back().get(), std::memory_order_relaxed);
 #ifdef BLOOM_FILTER_ENABLE
-    std::cout << "Bloom filter enabled." << std::endl;
-    size_t bloom_size = key_size * 10;
-    size_t hash_size = static_cast<size_t>(
-        std::ceil(std::log(1 / target_fpr) / std::log(2)));
-    blm_ = BloomFilter(bloom_size, hash_size);
+    blm_ = BlockedBloomFilter(key_size, target_fpr);
 #else
-    std::cout << "Bloom filter disabled." << std::endl;
+    (void)key_size;
+    (void)target_fpr;
 #endif
   }
+  /**
+   * Thread-safe. With a max load factor set, also migrates a few buckets of
+   * a pending rehash, and starts one once the table holds more keys than
+   * the factor allows.
+   */
   void Insert(int key, int value);
+  /**
+   * Copies out the values stored under `key`. Locks the key's bucket, so it
+   * may run concurrently with Inserts, rehashes included.
+   */
   auto Get(int key) const -> std::vector<int>;
+  /**
+   * Calls `visit(value)` for every value stored under `key` without copying
+   * them out; the allocation-free alternative to Get for probe loops.
+   */
+  template <typename Visitor>
+  void ForEachMatch(int key, Visitor&& visit) const;
+  /**
+   * Calls `visit(value_r, value_s)` for every match of the `n` tuples at
+   * `kvs`. With the Bloom filter on, keys are prefiltered a batch at a time.
+   * With prefetching on, keys are looked up PREFETCH_GROUP_SIZE at a time in
+   * stages (bucket, entries, payloads), each stage prefetching what the next
+   * one reads, so a group's cache misses overlap instead of queueing.
+   */
+  template <typename Visitor>
+  auto ProbeBatch(const std::pair<int, int>* kvs, size_t n,
+                  Visitor&& visit) const -> ProbeCounts;
+  /**
+   * ProbeBatch for the outer joins: also calls `miss(kv)` for every tuple
+   * without a match, and with `mark` set flags each entry that matched so
+   * that ForEachUnmatched can emit the rest of R afterwards.
+   */
+  template <typename Visitor, typename Miss>
+  auto ProbeOuter(const std::pair<int, int>* kvs, size_t n, bool mark,
+                  Visitor&& visit, Miss&& miss) const -> ProbeCounts;
+  /**
+   * Calls `visit(value)` for every value of the entries in buckets
+   * [begin, end) that no marking probe matched. No rehash may be pending.
+   */
+  template <typename Visitor>
+  void ForEachUnmatched(size_t begin, size_t end, Visitor&& visit) const;
+  /**
+   * Whether `key` is stored; stops at the first equal entry. Like Get, may
+   * run concurrently with Inserts.
+   */
+  auto Contains(int key) const -> bool;
+  /**
+   * Key-column variant of ProbeBatch: calls `visit(row, value_r)` for every
+   * match of keys[row], row in [0, n).
+   * @return The key counts, with the Bloom prefilter's when it is on.
+   */
+  template <typename Visitor>
+  auto ProbeKeys(const int* keys, size_t n, Visitor&& visit) const
+      -> ProbeCounts;
   auto Build(std::vector<std::pair<int, int>>& kvs) -> void;
+  auto Build(const ColumnarRelation& rel) -> void;
 
   /**
    * @param kvs The keys and values need to join.
@@ -37,31 +115,491 @@ class HashTable {
    */
   auto Probe(std::vector<std::pair<int, int>>& kvs)
       -> std::vector<std::pair<int, int>>;
+  auto Probe(const ColumnarRelation& rel) -> ColumnarResult;
+
+  /**
+   * @return result[i] is the number of buckets holding i distinct keys. No
+   * rehash may be pending.
+   */
+  auto ChainLengthHistogram() const -> std::vector<size_t>;
+  auto size_in_bytes() const -> size_t;
+  auto num_buckets() const -> size_t {
+    return current_.load(std::memory_order_acquire)->size();
+  }
+  /**
+   * Turns group prefetching in the batched probes on (the default) or off.
+   */
+  void SetPrefetch(bool on) { prefetch_ = on; }
+  /**
+   * Lets the table grow: once it holds more than `load` distinct keys per
+   * bucket, Insert doubles the buckets. The old entries move over
+   * incrementally, REHASH_BUCKETS_PER_INSERT old buckets per Insert, and
+   * lookups check the old bucket of a key until it has moved, so probes see
+   * every key at any point of a rehash. The lock-free probes (ForEachMatch,
+   * ProbeBatch, ProbeKeys) still need the Inserts to be done; Get and
+   * Contains do not. 0 (the default) keeps the bucket count fixed. Not to
+   * be changed during Inserts.
+   */
+  void SetMaxLoadFactor(double load) { max_load_factor_ = load; }
+  /**
+   * Moves whatever a pending rehash has left, together with any other
+   * thread calling it. Inserting threads call it once they are done, so
+   * that the probes and scans after the build find a single bucket array.
+   */
+  void FinishRehash();
 
  private:
-  auto hash(int key) const -> size_t;
-  auto getCollisionCount(int key) -> size_t;
+  static auto bucket_bits(size_t num_buckets) -> int {
+    int bits = 1;
+    while ((size_t{1} << bits) < num_buckets) {
+      ++bits;
+    }
+    return bits;
+  }
+  auto getCollisionCount(size_t bucket) const -> size_t;
+  // Returns whether `key` was found; with kMark also flags its entry.
+  template <bool kMark = false, typename Visitor>
+  auto visitBucket(int key, Visitor&& visit) const -> bool;
+  template <bool kMark, typename Visitor, typename Miss>
+  auto probeBatch(const std::pair<int, int>* kvs, size_t n, Visitor&& visit,
+                  Miss&& miss) const -> ProbeCounts;
+  // Probes the `n` <= PREFETCH_GROUP_SIZE tuples at `group` in stages.
+  template <bool kMark, typename Visitor, typename Miss>
+  auto probeGroup(const std::pair<int, int>* const* group, size_t n,
+                  Visitor&& visit, Miss&& miss) const -> size_t;
+  // The payloads of one key. Entries and payloads live in the arenas and
+  // are trivially destructible, so dropping the table unmaps a few chunks
+  // instead of freeing every key's array.
+  struct Entry {
+    int key;
+    uint32_t size;
+    uint32_t capacity;
+    // Set by marking probes with relaxed atomics; read only after they have
+    // joined.
+    mutable uint8_t matched;
+    int* values;
+
+    auto begin() const -> const int* { return values; }
+    auto end() const -> const int* { return values + size; }
+  };
   struct Bucket {
-    std::mutex mtx;
-    std::vector<std::pair<int, std::vector<int>>> entries;
-    // int key;
-    // std::vector<int> values;
+    mutable std::mutex mtx;
+    Entry* entries = nullptr;
+    uint32_t size = 0;
+    uint32_t capacity = 0;
+    // Set under mtx, with release, once a rehash has moved the entries to
+    // the next array; a reader that sees it set also sees them there.
+    std::atomic<bool> migrated{false};
+
+    auto begin() const -> const Entry* { return entries; }
+    auto end() const -> const Entry* { return entries + size; }
   };
-  std::vector<Bucket> buckets;
+  struct BucketArray {
+    explicit BucketArray(int bits)
+        : bits(bits), buckets(new Bucket[size_t{1} << bits]) {}
+    auto size() const -> size_t { return size_t{1} << bits; }
+    auto bucket(int key) const -> Bucket& {
+      return buckets[probe_hash(key, bits)];
+    }
+
+    int bits;
+    std::unique_ptr<Bucket[]> buckets;
+    // While this array is rehashed: the next bucket to hand out and the
+    // number of handed-out buckets known to have moved.
+    std::atomic<size_t> cursor{0};
+    std::atomic<size_t> moved{0};
+  };
+  // The bucket holding `key`: in the old array while a rehash has not moved
+  // it yet. Unlocked, so its entries may change under a concurrent Insert.
+  auto bucketOf(int key) const -> const Bucket&;
+  // bucketOf, locked with `lock` and safe to read during Inserts.
+  auto lockedBucketOf(int key, std::unique_lock<std::mutex>& lock) const
+      -> const Bucket&;
+  // Adds `value` under `key` to the locked `bucket`; returns whether the key
+  // is new.
+  auto insertLocked(Bucket& bucket, int key, int value) -> bool;
+  // Counts a new key and grows `table` past the max load factor.
+  void keyAdded(BucketArray* table);
+  // Adds `entry` to the locked `bucket`, growing its entry array.
+  void appendEntry(Bucket& bucket, const Entry& entry);
+  // Moves bucket `b` of `from` to the two buckets of `to` it splits into.
+  void migrate(BucketArray* from, BucketArray* to, size_t b);
+  // Moves up to `n` buckets of the rehash from `from` to `to`.
+  void helpRehash(BucketArray* from, BucketArray* to, size_t n);
+  // Starts a rehash of `full` into twice the buckets unless the table grew
+  // already or a rehash is pending.
+  void grow(BucketArray* full);
+  // An arena's first chunk: its thread's share of `key_size` keys.
+  static auto first_chunk(size_t key_size) -> size_t;
+
+  // Grown by doubling from the calling thread's arena.
+  static constexpr uint32_t kInitialEntries = 2;
+  ArenaPool arena_;
+  // Every bucket array the table had, newest last. Old ones stay mapped so
+  // that a thread still holding one finds its buckets flagged as migrated.
+  std::vector<std::unique_ptr<BucketArray>> arrays_;
+  std::mutex grow_mtx_;
+  std::atomic<BucketArray*> current_{nullptr};
+  // The array a pending rehash moves into current_; null when none is.
+  std::atomic<BucketArray*> old_{nullptr};
+  double max_load_factor_ = 0;
+  alignas(64) std::atomic<size_t> num_keys_{0};
+  bool prefetch_ = true;
+  SimdLevel level_ = simd_level();
 
-  std::mutex blm_mtx;  // The mutex of bloom_filter
-  BloomFilter blm_;
+  BlockedBloomFilter blm_;  // insert() is thread-safe, no mutex needed.
 };
 
+template <typename Visitor>
+void HashTable::ForEachMatch(int key, Visitor&& visit) const {
+#ifdef BLOOM_FILTER_ENABLE
+  if (!blm_.contains(key)) {
+    return;
+  }
+#endif
+  visitBucket(key, visit);
+}
+
+template <typename Visitor>
+auto HashTable::ProbeBatch(const std::pair<int, int>* kvs, size_t n,
+                           Visitor&& visit) const -> ProbeCounts {
+  return probeBatch<false>(kvs, n, visit, [](const std::pair<int, int>&) {});
+}
+
+template <typename Visitor, typename Miss>
+auto HashTable::ProbeOuter(const std::pair<int, int>* kvs, size_t n,
+                           bool mark, Visitor&& visit, Miss&& miss) const
+    -> ProbeCounts {
+  return mark ? probeBatch<true>(kvs, n, visit, miss)
+              : probeBatch<false>(kvs, n, visit, miss);
+}
+
+template <typename Visitor>
+void HashTable::ForEachUnmatched(size_t begin, size_t end,
+                                 Visitor&& visit) const {
+  const BucketArray& table = *current_.load(std::memory_order_acquire);
+  for (size_t b = begin; b < end; ++b) {
+    for (const auto& entry : table.buckets[b]) {
+      if (!__atomic_load_n(&entry.matched, __ATOMIC_RELAXED)) {
+        for (int value : entry) {
+          visit(value);
+        }
+      }
+    }
+  }
+}
+
+template <bool kMark, typename Visitor, typename Miss>
+auto HashTable::probeBatch(const std::pair<int, int>* kvs, size_t n,
+                           Visitor&& visit, Miss&& miss) const -> ProbeCounts {
+  ProbeCounts counts;
+  counts.probed = n;
+  // Tuples waiting for a lookup; flushed a group at a time with prefetching
+  // on, one at a time without.
+  const std::pair<int, int>* group[PREFETCH_GROUP_SIZE];
+  size_t group_size = 0;
+  size_t group_limit = prefetch_ ? PREFETCH_GROUP_SIZE : 1;
+  auto flush = [&]() {
+    counts.found += probeGroup<kMark>(group, group_size, visit, miss);
+    group_size = 0;
+  };
+  auto probe = [&](const std::pair<int, int>& kv) {
+    group[group_size++] = &kv;
+    if (group_size == group_limit) {
+      flush();
+    }
+  };
+#ifdef BLOOM_FILTER_ENABLE
+  counts.filtered = true;
+  int keys[BLOOM_BATCH_SIZE];
+  uint32_t sel[BLOOM_BATCH_SIZE];
+  for (size_t base = 0; base < n; base += BLOOM_BATCH_SIZE) {
+    size_t len = std::min<size_t>(BLOOM_BATCH_SIZE, n - base);
+    for (size_t i = 0; i < len; ++i) {
+      keys[i] = kvs[base + i].first;
+    }
+    size_t hits = blm_.contains_batch(keys, len, sel);
+    counts.passed += hits;
+    // Rejected keys are the gaps between the selected rows.
+    size_t next = 0;
+    for (size_t i = 0; i < hits; ++i) {
+      for (; next < sel[i]; ++next) {
+        miss(kvs[base + next]);
+      }
+      probe(kvs[base + sel[i]]);
+      next = sel[i] + 1;
+    }
+    for (; next < len; ++next) {
+      miss(kvs[base + next]);
+    }
+  }
+#else
+  counts.passed = n;
+  for (size_t i = 0; i < n; ++i) {
+    probe(kvs[i]);
+  }
+#endif
+  flush();
+  return counts;
+}
+
+template <bool kMark, typename Visitor, typename Miss>
+auto HashTable::probeGroup(const std::pair<int, int>* const* group, size_t n,
+                           Visitor&& visit, Miss&& miss) const -> size_t {
+  if (n == 1) {
+    // Nothing to overlap with.
+    const auto& kv = *group[0];
+    bool found = visitBucket<kMark>(
+        kv.first, [&](int value_r) { visit(value_r, kv.second); });
+    if (!found) {
+      miss(kv);
+    }
+    return found;
+  }
+  int keys[PREFETCH_GROUP_SIZE];
+  uint32_t hashes[PREFETCH_GROUP_SIZE];
+  const Bucket* bucket[PREFETCH_GROUP_SIZE];
+  const Entry* entry[PREFETCH_GROUP_SIZE];
+  // Stage 1: hash the whole group in one go, prefetch the buckets.
+  for (size_t j = 0; j < n; ++j) {
+    keys[j] = group[j]->first;
+  }
+  const BucketArray& table = *current_.load(std::memory_order_acquire);
+  bool rehashing = old_.load(std::memory_order_acquire) != nullptr;
+  hash_keys(keys, n, table.bits, hashes, level_);
+  for (size_t j = 0; j < n; ++j) {
+    bucket[j] = rehashing ? &bucketOf(keys[j]) : &table.buckets[hashes[j]];
+    __builtin_prefetch(&bucket[j]->entries);
+  }
+  // Stage 2: prefetch each bucket's entry array.
+  for (size_t j = 0; j < n; ++j) {
+    __builtin_prefetch(bucket[j]->entries);
+  }
+  // Stage 3: find the entries, prefetch their payloads.
+  for (size_t j = 0; j < n; ++j) {
+    entry[j] = nullptr;
+    for (const auto& e : *bucket[j]) {
+      if (e.key == group[j]->first) {
+        entry[j] = &e;
+        __builtin_prefetch(e.values);
+        break;
+      }
+    }
+  }
+  // Stage 4: emit.
+  size_t found = 0;
+  for (size_t j = 0; j < n; ++j) {
+    const auto& kv = *group[j];
+    if (entry[j] == nullptr) {
+      miss(kv);
+      continue;
+    }
+    ++found;
+    if (kMark && !__atomic_load_n(&entry[j]->matched, __ATOMIC_RELAXED)) {
+      __atomic_store_n(&entry[j]->matched, 1, __ATOMIC_RELAXED);
+    }
+    for (int value : *entry[j]) {
+      visit(value, kv.second);
+    }
+  }
+  return found;
+}
+
+template <typename Visitor>
+auto HashTable::ProbeKeys(const int* keys, size_t n, Visitor&& visit) const
+    -> ProbeCounts {
+  ProbeCounts counts;
+  counts.probed = n;
+#ifdef BLOOM_FILTER_ENABLE
+  counts.filtered = true;
+  uint32_t sel[BLOOM_BATCH_SIZE];
+  for (size_t base = 0; base < n; base += BLOOM_BATCH_SIZE) {
+    size_t len = std::min<size_t>(BLOOM_BATCH_SIZE, n - base);
+    size_t hits = blm_.contains_batch(keys + base, len, sel);
+    counts.passed += hits;
+    for (size_t i = 0; i < hits; ++i) {
+      size_t row = base + sel[i];
+      counts.found += visitBucket(
+          keys[row], [&](int value_r) { visit(row, value_r); });
+    }
+  }
+#else
+  counts.passed = n;
+  for (size_t row = 0; row < n; ++row) {
+    counts.found += visitBucket(
+        keys[row], [&](int value_r) { visit(row, value_r); });
+  }
+#endif
+  return counts;
+}
+
+inline auto HashTable::bucketOf(int key) const -> const Bucket& {
+  const BucketArray* table = current_.load(std::memory_order_acquire);
+  if (const BucketArray* old = old_.load(std::memory_order_acquire)) {
+    const Bucket& bucket = old->bucket(key);
+    if (old != table && !bucket.migrated.load(std::memory_order_acquire)) {
+      return bucket;
+    }
+  }
+  return table->bucket(key);
+}
+
+template <bool kMark, typename Visitor>
+auto HashTable::visitBucket(int key, Visitor&& visit) const -> bool {
+  for (const auto& entry : bucketOf(key)) {
+    if (entry.key == key) {
+      // Test first so that hot keys do not bounce their line between cores.
+      if (kMark && !__atomic_load_n(&entry.matched, __ATOMIC_RELAXED)) {
+        __atomic_store_n(&entry.matched, 1, __ATOMIC_RELAXED);
+      }
+      for (int value : entry) {
+        visit(value);
+      }
+      return true;
+    }
+  }
+  return false;
+}
+
 void build_thread(const std::vector<std::pair<int, int>>& R, int start, int end,
                   HashTable& ht);
-void probe_thread(const std::vector<std::pair<int, int>>& S, int start, int end,
-                  const HashTable& ht,
-                  std::vector<std::pair<int, int>>& output);
+/**
+ * Probes S[start, end) and appends the matches to `output`, handing it to
+ * `sink` every SINK_BATCH_SIZE pairs when one is set. Counts the pairs in
+ * the returned ProbeCounts::matches.
+ */
+auto probe_thread(const std::vector<std::pair<int, int>>& S, int start,
+                  int end, const HashTable& ht,
+                  std::vector<std::pair<int, int>>& output,
+                  ResultSink* sink = nullptr, int thread_id = 0)
+    -> ProbeCounts;
+void build_thread(const std::vector<std::pair<int, int>>& R, int start, int end,
+                  ConcurrentHashTable& ht);
+/**
+ * Called by each build thread once it has inserted its share.
+ */
+void finish_build_thread(HashTable& ht);
+void finish_build_thread(ConcurrentHashTable& ht);
+auto probe_thread(const std::vector<std::pair<int, int>>& S, int start,
+                  int end, const ConcurrentHashTable& ht,
+                  std::vector<std::pair<int, int>>& output,
+                  ResultSink* sink = nullptr, int thread_id = 0)
+    -> ProbeCounts;
+
+/**
+ * Build and probe skeleton of the joins over one table shared by all
+ * threads, row- or column-wise alike. Threads pull morsels of the
+ * `build_rows` rows of R and pass each to `build(begin, end)`, then call
+ * finish_build_thread. Next they pull morsels of the `probe_rows` rows of S
+ * and pass each to `probe(i, begin, end, matches)`. That call adds the
+ * pairs it emits to `matches` and returns the morsel's ProbeCounts.
+ * `done(i)` runs after thread i's last morsel, and `merge()` builds the
+ * result once the probe phase has ended, timing itself as the merge phase. Fills options.stats except for the result's bytes, which the
+ * caller adds.
+ */
+template <typename Table, typename Build, typename Probe, typename Done,
+          typename Merge>
+auto shared_build_probe(Table& ht, size_t build_rows, size_t probe_rows,
+                        const JoinOptions& options, Build&& build,
+                        Probe&& probe, Done&& done, Merge&& merge)
+    -> decltype(merge()) {
+  int num_threads = join_threads(options);
+  JoinStats* stats = options.stats;
+  if (stats != nullptr) {
+    *stats = JoinStats();
+  }
+  PhaseTimer total_timer(nullptr, 0);
+  // Build: threads pull morsels of R and steal when their own run out.
+  PhaseTimer build_timer(stats ? &stats->build : nullptr, num_threads,
+                         options.perf_counters);
+  MorselScheduler build_sched(build_rows, num_threads);
+  run_parallel(options.pool, num_threads, [&](int i) {
+    build_timer.ThreadStart(i);
+    size_t begin, end, tuples = 0;
+    while (build_sched.Next(i, begin, end)) {
+      build(begin, end);
+      tuples += end - begin;
+    }
+    finish_build_thread(ht);
+    build_timer.ThreadDone(i, tuples);
+  });
+  build_timer.Finish();
+
+  // Probe
+  PhaseTimer probe_timer(stats ? &stats->probe : nullptr, num_threads,
+                         options.perf_counters);
+  MorselScheduler probe_sched(probe_rows, num_threads);
+  std::vector<ProbeCounts> counts(num_threads);
+  std::vector<size_t> matches(num_threads, 0);
+  run_parallel(options.pool, num_threads, [&](int i) {
+    probe_timer.ThreadStart(i);
+    size_t begin, end;
+    while (probe_sched.Next(i, begin, end)) {
+      counts[i] += probe(i, begin, end, matches[i]);
+    }
+    done(i);
+    probe_timer.ThreadDone(i, counts[i].probed);
+  });
+  probe_timer.Finish();
+  auto result = merge();
+  if (stats != nullptr) {
+    ProbeCounts total;
+    for (int i = 0; i < num_threads; ++i) {
+      total += counts[i];
+      stats->match_count += matches[i];
+    }
+    record_probe_counts(stats, total);
+    stats->chain_lengths = ht.ChainLengthHistogram();
+    stats->bytes_allocated = ht.size_in_bytes();
+    stats->total_ms = total_timer.ElapsedMs();
+  }
+  return result;
+}
 auto multi_threaded_hash_join(const std::vector<std::pair<int, int>>& R,
                               const std::vector<std::pair<int, int>>& S,
                               int num_threads = 8, size_t table_size = 10007,
-                              size_t key_size = 10000)
+                              size_t key_size = 10000,
+                              ThreadPool* pool = nullptr)
+    -> std::vector<std::pair<int, int>>;
+
+/**
+ * Radix-partitioned join: R and S are split on the low hash bits in
+ * `radix_passes` passes so that every partition's table fits in L2, then the
+ * partition pairs are joined in parallel without any locks.
+ * @param radix_bits Total number of radix bits, 0 to derive it from |R|.
+ * @param radix_passes Number of partition passes, 0 to derive it from bits.
+ * @param pool Workers to run on; nullptr spawns threads for this call.
+ * @param numa_aware Bind each node's block of partitions to that node's
+ * memory and have its threads join them first. Falls back to one node.
+ * @param numa_stats If set, filled with local/remote tuples per node.
+ */
+auto radix_hash_join(const std::vector<std::pair<int, int>>& R,
+                     const std::vector<std::pair<int, int>>& S,
+                     int num_threads = 8, int radix_bits = 0,
+                     int radix_passes = 0, ThreadPool* pool = nullptr,
+                     bool numa_aware = false, NumaStats* numa_stats = nullptr)
+    -> std::vector<std::pair<int, int>>;
+auto radix_hash_join(const std::vector<std::pair<int, int>>& R,
+                     const std::vector<std::pair<int, int>>& S,
+                     const JoinOptions& options)
     -> std::vector<std::pair<int, int>>;
 
+/**
+ * Runs the join with the algorithm selected in `options`.
+ */
+auto multi_threaded_hash_join(const std::vector<std::pair<int, int>>& R,
+                              const std::vector<std::pair<int, int>>& S,
+                              const JoinOptions& options)
+    -> std::vector<std::pair<int, int>>;
+
+/**
+ * Columnar join. The shared-table algorithms read the key and payload
+ * columns in place and write result columns per thread; the other
+ * algorithms interleave into pairs first. With `options.sink` set, matches
+ * are streamed as pairs and the result is empty.
+ */
+auto multi_threaded_hash_join(const ColumnarRelation& R,
+                              const ColumnarRelation& S,
+                              const JoinOptions& options) -> ColumnarResult;
+
 };  // namespace hashjoin
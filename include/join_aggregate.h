@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "join_options.h"
+
+namespace hashjoin {
+
+/**
+ * Aggregates of one group of a fused join, over its joined (r, s) rows.
+ */
+struct JoinAggregate {
+  int key = 0;         // The join key with GroupBy::kJoinKey, else 0.
+  uint64_t count = 0;  // COUNT(*)
+  int64_t sum_r = 0;   // SUM(value_r)
+  int64_t sum_s = 0;   // SUM(value_s)
+};
+
+enum class GroupBy {
+  kNone,     // One row over the whole join.
+  kJoinKey,  // One row per join key with at least one match.
+};
+
+/**
+ * Join + COUNT/SUM without materializing the matches. The build
+ * pre-aggregates R to a (count, sum) per distinct key, so an S tuple adds
+ * count, sum and value_s * count to its group in O(1) however many R
+ * duplicates it matches. Threads keep partial aggregates and merge them at
+ * the end, so memory is O(distinct keys of R + groups per thread). Only
+ * `num_threads`, `pool`, `stats` and `perf_counters` are read from
+ * `options`.
+ * @return One row for GroupBy::kNone, else one row per group in no
+ * particular order.
+ */
+auto join_aggregate(const std::vector<std::pair<int, int>>& R,
+                    const std::vector<std::pair<int, int>>& S,
+                    const JoinOptions& options,
+                    GroupBy group_by = GroupBy::kNone)
+    -> std::vector<JoinAggregate>;
+
+};  // namespace hashjoin
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <limits>
+
+namespace hashjoin {
+
+class ThreadPool;
+class ResultSink;
+struct NumaStats;
+struct GraceStats;
+struct JoinStats;
+
+enum class JoinAlgorithm {
+  kSharedHashTable,    // One HashTable shared by all threads.
+  kRadixPartitioned,   // radix_hash_join.
+  kLockFreeHashTable,  // One ConcurrentHashTable, built without locks.
+  kSortMerge,          // sort_merge_join.
+  kGraceHashJoin,      // grace_hash_join, bounded by memory_budget.
+};
+
+// What a join emits; R is always the build side and S the probe side.
+enum class JoinType {
+  kInner,       // (value_r, value_s) for every match.
+  kSemi,        // Every S tuple (key, value_s) with a match in R.
+  kAnti,        // Every S tuple (key, value_s) without a match in R.
+  kLeftOuter,   // kInner plus (value_r, kNullValue) for every unmatched R.
+  kRightOuter,  // kInner plus (kNullValue, value_s) for every unmatched S.
+};
+
+// Stands in for the missing side of an outer-join result.
+constexpr int kNullValue = std::numeric_limits<int>::min();
+
+struct JoinOptions {
+  JoinAlgorithm algorithm = JoinAlgorithm::kSharedHashTable;
+  // Anything but kInner runs on the shared-table path, see join_variants.h.
+  JoinType join_type = JoinType::kInner;
+  int num_threads = 8;
+  size_t table_size = 10007;
+  size_t key_size = 10000;
+  int radix_bits = 0;
+  int radix_passes = 0;
+  // Reused workers; when set, num_threads is taken from the pool's size.
+  ThreadPool* pool = nullptr;
+  // NUMA placement for kRadixPartitioned, see radix_hash_join.
+  bool numa_aware = false;
+  NumaStats* numa_stats = nullptr;
+  // When set, matches are streamed to it in batches and the join returns an
+  // empty vector.
+  ResultSink* sink = nullptr;
+  // Bytes kGraceHashJoin may spend on hash tables; 0 means unbounded.
+  size_t memory_budget = 0;
+  // Directory for kGraceHashJoin spill files, nullptr for the system temp.
+  const char* spill_dir = nullptr;
+  GraceStats* grace_stats = nullptr;
+  // When set, filled with per-phase timings and counters, see JoinStats.
+  JoinStats* stats = nullptr;
+  // kSharedHashTable only: detect heavy-hitter keys, see skew_aware_join.
+  bool skew_aware = false;
+  // Group-prefetching probes in the HashTable and ConcurrentHashTable joins;
+  // off probes one key at a time.
+  bool prefetch = true;
+  // Back the HashTable arenas with transparent huge pages.
+  bool huge_pages = false;
+  // Distinct keys per bucket beyond which a HashTable doubles its buckets
+  // during the build, so table_size is only a starting size; 0 keeps it.
+  // Entries of a bucket are contiguous, so a few per bucket cost less than
+  // the extra doublings a lower bound takes.
+  double max_load_factor = 4.0;
+  // With stats, also read per-thread hardware counters for each phase.
+  bool perf_counters = false;
+};
+
+};  // namespace hashjoin
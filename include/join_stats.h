@@ -0,0 +1,183 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "perf_counters.h"
+
+namespace hashjoin {
+
+/**
+ * Wall time and work of one join phase. thread_ms[i] is the time from the
+ * start of the phase until thread i finished its share, so the spread
+ * across threads shows load imbalance.
+ */
+struct PhaseStats {
+  double wall_ms = 0;
+  size_t tuples = 0;
+  std::vector<double> thread_ms;
+  std::vector<size_t> thread_tuples;
+  // Hardware counters, with JoinOptions::perf_counters; `counters` sums the
+  // threads.
+  std::vector<PerfCounts> thread_counters;
+  PerfCounts counters;
+};
+
+/**
+ * Filled in by a join when JoinOptions::stats is set. The shared-table joins
+ * have a build and a probe phase; the radix and Grace joins also partition;
+ * sort-merge reports its sort as partition and its merge join as probe.
+ * Every join ends with a merge phase that gathers the threads' outputs into
+ * the result. Phases a join does not have stay zero.
+ */
+struct JoinStats {
+  PhaseStats partition;
+  PhaseStats build;
+  PhaseStats probe;
+  PhaseStats merge;
+  double total_ms = 0;
+  // Result rows, including the null-padded ones of the outer joins.
+  size_t match_count = 0;
+  // chain_lengths[i] is the number of buckets whose chain has i entries, for
+  // the joins that build one shared table.
+  std::vector<size_t> chain_lengths;
+  // Probe keys the Bloom filter let through or rejected; 0 when it is off.
+  size_t bloom_passed = 0;
+  size_t bloom_rejected = 0;
+  // Share of the probe keys missing from R that still passed the filter.
+  double bloom_false_positive_rate = 0;
+  // Bytes held by the join's tables, partition buffers and result.
+  size_t bytes_allocated = 0;
+  // Keys skew_aware_join kept out of the shared table.
+  size_t heavy_hitters = 0;
+};
+
+/**
+ * Probe-side key counts of one probe call. `filtered` is set when a Bloom
+ * filter ran; otherwise every key counts as passed.
+ */
+struct ProbeCounts {
+  size_t probed = 0;
+  size_t passed = 0;
+  size_t found = 0;  // Keys with at least one match.
+  size_t matches = 0;  // Pairs emitted, where the caller counts them.
+  bool filtered = false;
+
+  auto operator+=(const ProbeCounts& other) -> ProbeCounts& {
+    probed += other.probed;
+    passed += other.passed;
+    found += other.found;
+    matches += other.matches;
+    filtered = filtered || other.filtered;
+    return *this;
+  }
+};
+
+/**
+ * Times one phase into `phase`; does nothing when `phase` is null, so a
+ * join without stats pays for a pointer test per thread.
+ */
+class PhaseTimer {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  /**
+   * @param perf_counters Also count hardware events between each thread's
+   * ThreadStart and ThreadDone.
+   */
+  PhaseTimer(PhaseStats* phase, int num_threads, bool perf_counters = false)
+      : phase_(phase), start_(Clock::now()) {
+    if (phase_ != nullptr) {
+      phase_->thread_ms.assign(num_threads, 0);
+      phase_->thread_tuples.assign(num_threads, 0);
+      if (perf_counters) {
+        counters_.resize(num_threads);
+        phase_->thread_counters.assign(num_threads, PerfCounts());
+      }
+    }
+  }
+
+  /**
+   * Called by thread `thread_id` before its share of the phase; counters are
+   * per thread, so they must be opened on that thread.
+   */
+  void ThreadStart(int thread_id) {
+    if (!counters_.empty()) {
+      counters_[thread_id].reset(new PerfCounters());
+      counters_[thread_id]->Start();
+    }
+  }
+
+  /**
+   * Called by thread `thread_id` once its share of the phase is done. A
+   * phase run as several parallel passes brackets each pass with
+   * ThreadStart and ThreadDone; tuples and counters add up.
+   */
+  void ThreadDone(int thread_id, size_t tuples) {
+    if (phase_ != nullptr) {
+      phase_->thread_ms[thread_id] = ElapsedMs();
+      phase_->thread_tuples[thread_id] += tuples;
+      if (!counters_.empty() && counters_[thread_id] != nullptr) {
+        phase_->thread_counters[thread_id] += counters_[thread_id]->Stop();
+        counters_[thread_id].reset();
+      }
+    }
+  }
+
+  /**
+   * Ends the phase. Tuples are summed from the threads unless given.
+   */
+  void Finish() const {
+    if (phase_ != nullptr) {
+      phase_->wall_ms = ElapsedMs();
+      phase_->tuples = 0;
+      for (size_t tuples : phase_->thread_tuples) {
+        phase_->tuples += tuples;
+      }
+      sumCounters();
+    }
+  }
+  void Finish(size_t tuples) const {
+    if (phase_ != nullptr) {
+      phase_->wall_ms = ElapsedMs();
+      phase_->tuples = tuples;
+      sumCounters();
+    }
+  }
+
+  auto ElapsedMs() const -> double {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start_)
+        .count();
+  }
+
+ private:
+  void sumCounters() const {
+    phase_->counters = PerfCounts();
+    for (const auto& counts : phase_->thread_counters) {
+      phase_->counters += counts;
+    }
+  }
+
+  PhaseStats* phase_;
+  Clock::time_point start_;
+  std::vector<std::unique_ptr<PerfCounters>> counters_;
+};
+
+/**
+ * Copies summed probe counts into the Bloom fields of `stats`.
+ */
+inline void record_probe_counts(JoinStats* stats, const ProbeCounts& counts) {
+  if (stats == nullptr || !counts.filtered) {
+    return;
+  }
+  stats->bloom_passed = counts.passed;
+  stats->bloom_rejected = counts.probed - counts.passed;
+  size_t misses = counts.probed - counts.found;
+  stats->bloom_false_positive_rate =
+      misses == 0 ? 0
+                  : static_cast<double>(counts.passed - counts.found) / misses;
+}
+
+};  // namespace hashjoin
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <utility>
+#include <vector>
+
+#include "join_options.h"
+
+namespace hashjoin {
+
+/**
+ * kSemi and kAnti joins. R only has to answer whether a key exists, so it is
+ * built into a ConcurrentKeySet without payloads, and each S tuple is done
+ * at its first hit.
+ * @return The S tuples (key, value_s) that have (kSemi) or lack (kAnti) a
+ * match in R.
+ */
+auto semi_anti_join(const std::vector<std::pair<int, int>>& R,
+                    const std::vector<std::pair<int, int>>& S,
+                    const JoinOptions& options)
+    -> std::vector<std::pair<int, int>>;
+
+/**
+ * kLeftOuter and kRightOuter joins over a shared HashTable. Unmatched S
+ * tuples are emitted as they are probed. For unmatched R tuples the probe
+ * flags every entry it hits, and a scan over the buckets emits the entries
+ * left unflagged.
+ * @return The matched (value_r, value_s) pairs plus the unmatched tuples of
+ * the preserved side, with kNullValue for the other one.
+ */
+auto outer_join(const std::vector<std::pair<int, int>>& R,
+                const std::vector<std::pair<int, int>>& S,
+                const JoinOptions& options)
+    -> std::vector<std::pair<int, int>>;
+
+};  // namespace hashjoin
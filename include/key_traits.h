@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <type_traits>
+#include <utility>
+
+namespace hashjoin {
+
+/**
+ * Hash policy for the templated tables. hash() must put its best bits at the
+ * top: tables index with the high bits and partitioners with the middle ones.
+ */
+template <typename Key, typename = void>
+struct KeyTraits {
+  static auto hash(const Key& key) -> uint64_t {
+    return static_cast<uint64_t>(std::hash<Key>()(key)) * 0x9E3779B97F4A7C15ULL;
+  }
+  static auto equal(const Key& a, const Key& b) -> bool { return a == b; }
+};
+
+/**
+ * Fixed-width integer keys: Fibonacci hashing on the raw bits and a single
+ * register compare, with no std::hash call in between.
+ */
+template <typename Key>
+struct KeyTraits<Key, typename std::enable_if<std::is_integral<Key>::value>::type> {
+  static auto hash(Key key) -> uint64_t {
+    return static_cast<uint64_t>(
+               static_cast<typename std::make_unsigned<Key>::type>(key)) *
+           0x9E3779B97F4A7C15ULL;
+  }
+  static auto equal(Key a, Key b) -> bool { return a == b; }
+};
+
+/**
+ * Composite keys. The second hash gets another multiply so that equal
+ * halves do not cancel out.
+ */
+template <typename A, typename B>
+struct KeyTraits<std::pair<A, B>> {
+  static auto hash(const std::pair<A, B>& key) -> uint64_t {
+    return KeyTraits<A>::hash(key.first) ^
+           KeyTraits<B>::hash(key.second) * 0x9E3779B97F4A7C15ULL;
+  }
+  static auto equal(const std::pair<A, B>& a, const std::pair<A, B>& b)
+      -> bool {
+    return KeyTraits<A>::equal(a.first, b.first) &&
+           KeyTraits<B>::equal(a.second, b.second);
+  }
+};
+
+};  // namespace hashjoin
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+#include "config.h"  // NOLINT
+
+namespace hashjoin {
+
+/**
+ * Hands out [begin, end) morsels of an input of `num_items` tuples. Morsels
+ * start split evenly across one deque per worker; a worker takes from the
+ * front of its own deque and, once that is empty, steals from the back of
+ * the others. Each deque is a packed {head, tail} word updated with a CAS,
+ * so there are no locks.
+ */
+class MorselScheduler {
+ public:
+  MorselScheduler(size_t num_items, int num_workers,
+                  size_t morsel_size = MORSEL_SIZE);
+
+  /**
+   * Fetches the next morsel for `worker`.
+   * @return false once every morsel has been handed out.
+   */
+  auto Next(int worker, size_t& begin, size_t& end) -> bool;
+
+ private:
+  struct alignas(64) Deque {
+    std::atomic<uint64_t> range;  // head in the high half, tail in the low.
+  };
+
+  auto popFront(Deque& deque, uint32_t& morsel) -> bool;
+  auto popBack(Deque& deque, uint32_t& morsel) -> bool;
+
+  size_t num_items_;
+  size_t morsel_size_;
+  int num_workers_;
+  std::unique_ptr<Deque[]> deques_;
+};
+
+};  // namespace hashjoin
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace hashjoin {
+
+/**
+ * Tuples a NUMA-aware join consumed per node of the consuming thread, split
+ * by whether the partition's memory was on that node or another one.
+ */
+struct NumaStats {
+  std::vector<size_t> local_tuples;
+  std::vector<size_t> remote_tuples;
+};
+
+/**
+ * Number of NUMA nodes with at least one CPU this process may run on, read
+ * from /sys/devices/system/node. 1 when the topology is unknown.
+ */
+auto numa_num_nodes() -> int;
+
+/**
+ * Restricts the calling thread to the CPUs of logical node `node`.
+ * @return false if affinity could not be set; the thread is left as is.
+ */
+auto numa_bind_thread(int node) -> bool;
+
+/**
+ * Binds the calling thread to node `node` for its lifetime, then gives the
+ * thread back the CPUs it had before, so that a pool worker leaves a task
+ * with its own pinning intact.
+ */
+class NumaThreadBinding {
+ public:
+  explicit NumaThreadBinding(int node);
+  ~NumaThreadBinding();
+  NumaThreadBinding(const NumaThreadBinding&) = delete;
+  auto operator=(const NumaThreadBinding&) -> NumaThreadBinding& = delete;
+
+  auto bound() const -> bool { return bound_; }
+
+ private:
+  std::vector<int> saved_cpus_;
+  bool bound_ = false;
+};
+
+/**
+ * Page-aligned anonymous memory that is not touched on allocation, so page
+ * ranges can be bound to a node (mbind) before their first write.
+ */
+class NumaRegion {
+ public:
+  NumaRegion() = default;
+  explicit NumaRegion(size_t bytes);
+  ~NumaRegion();
+  NumaRegion(NumaRegion&& other) noexcept;
+  auto operator=(NumaRegion&& other) noexcept -> NumaRegion&;
+  NumaRegion(const NumaRegion&) = delete;
+  auto operator=(const NumaRegion&) -> NumaRegion& = delete;
+
+  /**
+   * Binds the whole pages inside [offset, offset + len) to logical node
+   * `node`. Partial pages at either end keep the default policy.
+   * @return false if the kernel refused or the range has no whole page.
+   */
+  auto BindToNode(size_t offset, size_t len, int node) -> bool;
+  /**
+   * Asks for transparent huge pages over the region (MADV_HUGEPAGE); call it
+   * before the first write. Only the 2 MiB-aligned parts can be backed.
+   * @return false if the kernel refused or has no THP support.
+   */
+  auto AdviseHugePages() -> bool;
+
+  auto data() const -> void* { return data_; }
+  auto size() const -> size_t { return size_; }
+
+ private:
+  void release();
+
+  void* data_ = nullptr;
+  size_t size_ = 0;
+};
+
+};  // namespace hashjoin
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+
+namespace hashjoin {
+
+/**
+ * Hardware event counts of one thread over one phase. `available` is false
+ * when no counter could be opened (no PMU access, e.g. in a container or
+ * with a strict perf_event_paranoid); the counts are then all zero.
+ */
+struct PerfCounts {
+  uint64_t cycles = 0;
+  uint64_t instructions = 0;
+  uint64_t llc_misses = 0;
+  uint64_t dtlb_misses = 0;
+  uint64_t branch_misses = 0;
+  bool available = false;
+
+  auto operator+=(const PerfCounts& other) -> PerfCounts& {
+    cycles += other.cycles;
+    instructions += other.instructions;
+    llc_misses += other.llc_misses;
+    dtlb_misses += other.dtlb_misses;
+    branch_misses += other.branch_misses;
+    available = available || other.available;
+    return *this;
+  }
+};
+
+/**
+ * perf_event_open counters for the calling thread, user space only. Each
+ * event is opened on its own and scaled by its enabled/running time, so a
+ * PMU with fewer slots multiplexes instead of failing. Events the kernel
+ * refuses read as zero. Linux only; elsewhere it is never available.
+ */
+class PerfCounters {
+ public:
+  static constexpr int kNumEvents = 5;
+
+  PerfCounters();
+  ~PerfCounters();
+  PerfCounters(const PerfCounters&) = delete;
+  auto operator=(const PerfCounters&) -> PerfCounters& = delete;
+
+  void Start();
+  auto Stop() -> PerfCounts;
+
+  auto available() const -> bool;
+
+ private:
+  int fds_[kNumEvents];
+};
+
+};  // namespace hashjoin
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace hashjoin {
+
+/**
+ * Instruction sets the probe kernels can run on. simd_level() picks the best
+ * one the CPU has at run time, so one binary runs everywhere.
+ */
+enum class SimdLevel {
+  kScalar,
+  kAvx2,    // 8 keys per instruction.
+  kAvx512,  // 16 keys per instruction, AVX-512F.
+};
+
+auto simd_level() -> SimdLevel;
+
+// Fibonacci multiplier for 32-bit keys.
+constexpr uint32_t kProbeHashMultiplier = 0x9E3779B1U;
+
+/**
+ * Multiplicative hash into a power-of-two table of 2^bits slots, 1 <= bits
+ * <= 31: the top bits of key * kProbeHashMultiplier, so no division.
+ */
+inline auto probe_hash(int key, int bits) -> uint32_t {
+  return (static_cast<uint32_t>(key) * kProbeHashMultiplier) >> (32 - bits);
+}
+
+/**
+ * out[i] = probe_hash(keys[i], bits) for i in [0, n).
+ */
+void hash_keys(const int* keys, size_t n, int bits, uint32_t* out,
+               SimdLevel level = simd_level());
+
+/**
+ * Looks up `n` keys in an open-addressing table of 2^bits int slots that was
+ * filled by linear probing from probe_hash, with `empty` in the free slots.
+ * Keys equal to `empty` are never found. The table must not change during
+ * the call.
+ * @param sel Filled with the rows i whose keys[i] is in the table, in order.
+ * @param slot_of If set, slot_of[j] is filled with the slot of row sel[j].
+ * @return The number of rows written to `sel`.
+ */
+auto find_keys(const int* slots, int bits, int empty, const int* keys,
+               size_t n, uint32_t* sel, uint32_t* slot_of = nullptr,
+               SimdLevel level = simd_level()) -> size_t;
+
+};  // namespace hashjoin
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "columnar.h"
+
+namespace hashjoin {
+
+/**
+ * On-disk layout of a relation file: this header, then the key column and,
+ * unless kNoPayloads is set, the payload column. Both are native-endian
+ * int32 arrays starting at the given offsets, which are multiples of 64 so
+ * a mapped column is cache-line aligned.
+ */
+struct RelationFileHeader {
+  static constexpr char kMagic[8] = {'H', 'J', 'R', 'E', 'L', 'v', '1', '\0'};
+  static constexpr uint32_t kNoPayloads = 1;
+
+  char magic[8];
+  uint32_t flags;
+  uint32_t reserved;
+  uint64_t num_rows;
+  uint64_t key_offset;
+  uint64_t payload_offset;  // 0 with kNoPayloads.
+};
+
+/**
+ * Writes `rel` to `path`, replacing the file. With null payloads only the
+ * key column is stored and readers get row ids back.
+ * Throws std::system_error if the file cannot be written.
+ */
+void write_relation_file(const char* path, const ColumnarRelation& rel);
+void write_relation_file(const char* path,
+                         const std::vector<std::pair<int, int>>& rel);
+
+/**
+ * A relation file mapped read-only. relation() points straight into the
+ * mapping, so the columnar join overloads read it without parsing or
+ * copying. Throws std::system_error if the file cannot be mapped and
+ * std::runtime_error if it is not a valid relation file.
+ */
+class MappedRelation {
+ public:
+  explicit MappedRelation(const char* path);
+  ~MappedRelation();
+  MappedRelation(const MappedRelation&) = delete;
+  auto operator=(const MappedRelation&) -> MappedRelation& = delete;
+
+  auto relation() const -> ColumnarRelation { return rel_; }
+  auto size() const -> size_t { return rel_.size; }
+  /**
+   * Copies the relation out as pairs for the pair-based join entry points.
+   */
+  auto ToPairs() const -> std::vector<std::pair<int, int>>;
+
+ private:
+  void* data_ = nullptr;
+  size_t bytes_ = 0;
+  ColumnarRelation rel_;
+};
+
+};  // namespace hashjoin
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "config.h"  // NOLINT
+#include "join_stats.h"
+#include "thread_pool.h"
+
+namespace hashjoin {
+
+/**
+ * Push-based consumer of join results. Join threads hand their matches over
+ * in chunks as they produce them, so the full result is never materialized.
+ * Consume may run concurrently for different thread_ids; calls with the same
+ * thread_id never overlap.
+ */
+class ResultSink {
+ public:
+  virtual ~ResultSink() = default;
+  /**
+   * @param thread_id Index of the producing join thread.
+   * @param pairs (value_r, value_s) pairs, only valid during the call.
+   */
+  virtual void Consume(int thread_id, const std::pair<int, int>* pairs,
+                       size_t count) = 0;
+};
+
+/**
+ * Counts matches in one cache-line padded counter per thread slot.
+ */
+class CountingSink : public ResultSink {
+ public:
+  explicit CountingSink(int num_slots = 8)
+      : counters_(num_slots > 0 ? num_slots : 1) {}
+  void Consume(int thread_id, const std::pair<int, int>*,
+               size_t count) override {
+    counters_[thread_id % counters_.size()].value.fetch_add(
+        count, std::memory_order_relaxed);
+  }
+  auto count() const -> size_t {
+    size_t total = 0;
+    for (const auto& c : counters_) {
+      total += c.value.load(std::memory_order_relaxed);
+    }
+    return total;
+  }
+
+ private:
+  struct alignas(64) Counter {
+    std::atomic<size_t> value{0};
+  };
+  std::vector<Counter> counters_;
+};
+
+/**
+ * Forwards every chunk to a callable, e.g. a lambda writing to a file.
+ */
+class FunctionSink : public ResultSink {
+ public:
+  using Fn = std::function<void(int, const std::pair<int, int>*, size_t)>;
+  explicit FunctionSink(Fn fn) : fn_(std::move(fn)) {}
+  void Consume(int thread_id, const std::pair<int, int>* pairs,
+               size_t count) override {
+    fn_(thread_id, pairs, count);
+  }
+
+ private:
+  Fn fn_;
+};
+
+/**
+ * Hands `out` over to `sink` and clears it (keeping its capacity) once it
+ * holds at least `min_batch` pairs. No-op without a sink. Join threads call
+ * it with `min_batch` 0 after their last match; the chunks before that go
+ * through emit_to_sink.
+ */
+inline void flush_to_sink(ResultSink* sink, int thread_id,
+                          std::vector<std::pair<int, int>>& out,
+                          size_t min_batch = SINK_BATCH_SIZE) {
+  if (sink != nullptr && !out.empty() && out.size() >= min_batch) {
+    sink->Consume(thread_id, out.data(), out.size());
+    out.clear();
+  }
+}
+
+/**
+ * Gathers the threads' `outputs` into one result, thread i copying its own
+ * output into place, and frees them. Timed as the merge phase of
+ * options.stats, with counters when options.perf_counters is set.
+ */
+inline auto merge_outputs(std::vector<std::vector<std::pair<int, int>>>& outputs,
+                          const JoinOptions& options)
+    -> std::vector<std::pair<int, int>> {
+  int num_threads = static_cast<int>(outputs.size());
+  JoinStats* stats = options.stats;
+  PhaseTimer merge_timer(stats ? &stats->merge : nullptr, num_threads,
+                         options.perf_counters);
+  std::vector<size_t> offsets(num_threads + 1, 0);
+  for (int i = 0; i < num_threads; ++i) {
+    offsets[i + 1] = offsets[i] + outputs[i].size();
+  }
+  std::vector<std::pair<int, int>> result(offsets[num_threads]);
+  if (!result.empty()) {
+    run_parallel(options.pool, num_threads, [&](int i) {
+      merge_timer.ThreadStart(i);
+      std::copy(outputs[i].begin(), outputs[i].end(),
+                result.begin() + offsets[i]);
+      std::vector<std::pair<int, int>>().swap(outputs[i]);
+      merge_timer.ThreadDone(i, offsets[i + 1] - offsets[i]);
+    });
+  }
+  merge_timer.Finish();
+  return result;
+}
+
+/**
+ * Appends `pair` to `out` and, with a sink, hands `out` over as soon as it
+ * holds SINK_BATCH_SIZE pairs. Called from inside match loops, so that a
+ * key with a large fan-out streams out in chunks of SINK_BATCH_SIZE instead
+ * of piling up until the work unit ends.
+ */
+inline void emit_to_sink(ResultSink* sink, int thread_id,
+                         std::vector<std::pair<int, int>>& out,
+                         const std::pair<int, int>& pair) {
+  out.push_back(pair);
+  if (sink != nullptr && out.size() >= SINK_BATCH_SIZE) {
+    sink->Consume(thread_id, out.data(), out.size());
+    out.clear();
+  }
+}
+
+};  // namespace hashjoin
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <utility>
+#include <vector>
+
+#include "join_options.h"
+
+namespace hashjoin {
+
+/**
+ * Shared-table join that keeps heavy-hitter keys out of the HashTable. Keys
+ * seen at least SKEW_MIN_SAMPLE_HITS times in a strided sample of
+ * SKEW_SAMPLE_SIZE R tuples are heavy: build threads collect their payloads
+ * in thread-local lists instead of contending on one bucket mutex, and
+ * probe threads set matching S tuples aside. The heavy cross products are
+ * then cut into chunks of R payloads and spread over all threads. Other
+ * keys go through the table as usual. Used for kSharedHashTable when
+ * JoinOptions::skew_aware is set.
+ * @return The matched (value_r, value_s) pairs.
+ */
+auto skew_aware_join(const std::vector<std::pair<int, int>>& R,
+                     const std::vector<std::pair<int, int>>& S,
+                     const JoinOptions& options)
+    -> std::vector<std::pair<int, int>>;
+
+};  // namespace hashjoin
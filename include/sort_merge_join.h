@@ -0,0 +1,48 @@
+#pragma once
+
+#include <utility>
+#include <vector>
+
+#include "join_options.h"
+#include "join_stats.h"
+
+namespace hashjoin {
+
+/**
+ * Sorts `rel` by key with a parallel LSD radix sort (8-bit digits, stable).
+ * Digits shared by every key are skipped, and an already sorted input is
+ * returned as is, so re-sorting a sorted relation costs one scan. With a
+ * `timer`, every thread's share of each pass is bracketed on it.
+ */
+void sort_by_key(std::vector<std::pair<int, int>>& rel, int num_threads = 8,
+                 ThreadPool* pool = nullptr, PhaseTimer* timer = nullptr);
+
+/**
+ * Merge-joins two relations that are already sorted by key. The key space
+ * is cut at quantiles of the larger side and each range is merged by one
+ * thread.
+ * @return The matched (value_r, value_s) pairs.
+ */
+auto merge_join_sorted(const std::vector<std::pair<int, int>>& R,
+                       const std::vector<std::pair<int, int>>& S,
+                       int num_threads = 8, ThreadPool* pool = nullptr)
+    -> std::vector<std::pair<int, int>>;
+auto merge_join_sorted(const std::vector<std::pair<int, int>>& R,
+                       const std::vector<std::pair<int, int>>& S,
+                       const JoinOptions& options)
+    -> std::vector<std::pair<int, int>>;
+
+/**
+ * Sort-merge join: sorts copies of R and S with sort_by_key, then runs
+ * merge_join_sorted. Produces the same pairs as multi_threaded_hash_join.
+ */
+auto sort_merge_join(const std::vector<std::pair<int, int>>& R,
+                     const std::vector<std::pair<int, int>>& S,
+                     int num_threads = 8, ThreadPool* pool = nullptr)
+    -> std::vector<std::pair<int, int>>;
+auto sort_merge_join(const std::vector<std::pair<int, int>>& R,
+                     const std::vector<std::pair<int, int>>& S,
+                     const JoinOptions& options)
+    -> std::vector<std::pair<int, int>>;
+
+};  // namespace hashjoin
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "join_options.h"
+
+namespace hashjoin {
+
+/**
+ * Long-lived workers reused across joins. Workers park on a condition
+ * variable between phases instead of being respawned per phase.
+ */
+class ThreadPool {
+ public:
+  /**
+   * @param pin_threads Pin worker i to CPU i (mod the CPU count), Linux only.
+   */
+  explicit ThreadPool(int num_threads = 8, bool pin_threads = false);
+  ~ThreadPool();
+  ThreadPool(const ThreadPool&) = delete;
+  auto operator=(const ThreadPool&) -> ThreadPool& = delete;
+
+  /**
+   * Runs task(i) for every i in [0, num_tasks) and returns when all are done.
+   * Worker w runs tasks w, w + size(), ... Calls from several threads are
+   * serialized; a task must not call Run on the same pool.
+   */
+  void Run(int num_tasks, const std::function<void(int)>& task);
+
+  auto size() const -> int { return static_cast<int>(workers_.size()); }
+
+ private:
+  void workerLoop(int id, bool pin);
+
+  std::vector<std::thread> workers_;
+  std::mutex run_mtx_;  // Serializes Run callers.
+  std::mutex mtx_;
+  std::condition_variable wake_cv_;
+  std::condition_variable done_cv_;
+  const std::function<void(int)>* task_ = nullptr;
+  int num_tasks_ = 0;
+  int pending_ = 0;
+  uint64_t generation_ = 0;
+  bool stop_ = false;
+};
+
+/**
+ * Runs task(i) for i in [0, num_threads): on `pool` when one is given,
+ * otherwise on freshly spawned threads.
+ */
+void run_parallel(ThreadPool* pool, int num_threads,
+                  const std::function<void(int)>& task);
+
+/**
+ * Thread count a join runs with: the pool's size when one is set.
+ */
+inline auto join_threads(const JoinOptions& options) -> int {
+  return options.pool != nullptr ? options.pool->size() : options.num_threads;
+}
+
+};  // namespace hashjoin
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "flat_hash_table.h"
+#include "join_options.h"
+#include "morsel_scheduler.h"
+#include "thread_pool.h"
+
+namespace hashjoin {
+
+/**
+ * Join over any key and payload type, for keys that do not fit in an int
+ * (64-bit ids, composite keys) or wider payloads. Each thread scatters its
+ * slice of R and S into hash partitions; partitions are then joined
+ * independently with a BasicFlatHashTable, so no table is shared. Only
+ * `num_threads` and `pool` are read from `options`.
+ * @tparam Traits Hash policy, see KeyTraits.
+ * @return The matched (value_r, value_s) pairs.
+ */
+template <typename Key, typename Value, typename Traits = KeyTraits<Key>>
+auto typed_hash_join(const std::vector<std::pair<Key, Value>>& R,
+                     const std::vector<std::pair<Key, Value>>& S,
+                     const JoinOptions& options)
+    -> std::vector<std::pair<Value, Value>> {
+  using KeyValue = std::pair<Key, Value>;
+  using Partitions = std::vector<std::vector<KeyValue>>;
+  int num_threads = join_threads(options);
+  size_t num_partitions = 1;
+  while (num_partitions < static_cast<size_t>(num_threads) * 4) {
+    num_partitions <<= 1;
+  }
+  // Tables index with the top hash bits; partition on lower ones.
+  auto partition_of = [&](const Key& key) -> size_t {
+    return (Traits::hash(key) >> 16) & (num_partitions - 1);
+  };
+
+  // Partition
+  std::vector<Partitions> r_parts(num_threads, Partitions(num_partitions));
+  std::vector<Partitions> s_parts(num_threads, Partitions(num_partitions));
+  run_parallel(options.pool, num_threads, [&](int i) {
+    auto scatter = [&](const std::vector<KeyValue>& rel, Partitions& parts) {
+      size_t begin = rel.size() * i / num_threads;
+      size_t end = rel.size() * (i + 1) / num_threads;
+      for (size_t row = begin; row < end; ++row) {
+        parts[partition_of(rel[row].first)].push_back(rel[row]);
+      }
+    };
+    scatter(R, r_parts[i]);
+    scatter(S, s_parts[i]);
+  });
+
+  // Join
+  MorselScheduler scheduler(num_partitions, num_threads, 1);
+  std::vector<std::vector<std::pair<Value, Value>>> outputs(num_threads);
+  run_parallel(options.pool, num_threads, [&](int i) {
+    std::vector<KeyValue> build;
+    size_t begin, end;
+    while (scheduler.Next(i, begin, end)) {
+      for (size_t p = begin; p < end; ++p) {
+        build.clear();
+        for (auto& parts : r_parts) {
+          build.insert(build.end(), parts[p].begin(), parts[p].end());
+        }
+        BasicFlatHashTable<Key, Value, Traits> table(build.size());
+        table.Build(build);
+        for (auto& parts : s_parts) {
+          for (const auto& kv : parts[p]) {
+            table.ForEachMatch(kv.first, [&](const Value& value_r) {
+              outputs[i].push_back({value_r, kv.second});
+            });
+          }
+        }
+      }
+    }
+  });
+
+  // Merge results
+  std::vector<std::pair<Value, Value>> result;
+  size_t total = 0;
+  for (auto& out : outputs) {
+    total += out.size();
+  }
+  result.reserve(total);
+  for (auto& out : outputs) {
+    result.insert(result.end(), out.begin(), out.end());
+  }
+  return result;
+}
+
+};  // namespace hashjoin
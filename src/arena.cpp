@@ -0,0 +1,74 @@
+#include "arena.h"
+
+#include <algorithm>
+#include <atomic>
+
+#include "config.h"  // NOLINT
+
+namespace hashjoin {
+
+namespace {
+
+// Huge pages are 2 MiB; chunks that can hold one are rounded to them so
+// none is left split, smaller ones to base pages.
+constexpr size_t kHugePageSize = 2 * 1024 * 1024;
+constexpr size_t kPageSize = 4096;
+
+}  // namespace
+
+void Arena::newChunk(size_t min_bytes) {
+  size_t bytes = std::max(next_chunk_, min_bytes);
+  size_t page = huge_pages_ && bytes >= kHugePageSize ? kHugePageSize
+                                                      : kPageSize;
+  bytes = (bytes + page - 1) / page * page;
+  next_chunk_ = std::min<size_t>(2 * next_chunk_, ARENA_CHUNK_SIZE);
+  chunks_.emplace_back(bytes);
+  if (huge_pages_) {
+    chunks_.back().AdviseHugePages();
+  }
+  cursor_ = static_cast<char*>(chunks_.back().data());
+  end_ = cursor_ + bytes;
+  reserved_ += bytes;
+}
+
+thread_local ArenaPool::Cache ArenaPool::cache_;
+
+ArenaPool::ArenaPool(bool huge_pages, size_t first_chunk)
+    : id_([] {
+        static std::atomic<uint64_t> next_id{1};
+        return next_id.fetch_add(1, std::memory_order_relaxed);
+      }()),
+      huge_pages_(huge_pages),
+      first_chunk_(first_chunk) {}
+
+auto ArenaPool::lookup() -> Arena& {
+  std::lock_guard<std::mutex> lock(mtx_);
+  auto self = std::this_thread::get_id();
+  for (auto& owned : arenas_) {
+    if (owned.owner == self) {
+      return *owned.arena;
+    }
+  }
+  arenas_.push_back({self, std::unique_ptr<Arena>(new Arena(huge_pages_, first_chunk_))});
+  return *arenas_.back().arena;
+}
+
+auto ArenaPool::bytes_reserved() const -> size_t {
+  std::lock_guard<std::mutex> lock(mtx_);
+  size_t bytes = 0;
+  for (const auto& owned : arenas_) {
+    bytes += owned.arena->bytes_reserved();
+  }
+  return bytes;
+}
+
+auto ArenaPool::bytes_used() const -> size_t {
+  std::lock_guard<std::mutex> lock(mtx_);
+  size_t bytes = 0;
+  for (const auto& owned : arenas_) {
+    bytes += owned.arena->bytes_used();
+  }
+  return bytes;
+}
+
+}  // namespace hashjoin
@@ -0,0 +1,120 @@
+#include "hashjoin.h"
+#include "morsel_scheduler.h"
+
+namespace hashjoin {
+
+namespace {
+
+/**
+ * Columnar counterpart of the shared-table join: morsels of R are inserted
+ * straight from the columns, and probes scan only S's key column, reading a
+ * payload only for rows that matched. Shares shared_build_probe with the
+ * row-wise join.
+ */
+template <typename Table>
+auto columnar_shared_join(Table& ht, const ColumnarRelation& R,
+                          const ColumnarRelation& S,
+                          const JoinOptions& options) -> ColumnarResult {
+  std::vector<ColumnarResult> outputs(join_threads(options));
+  // Only used with a sink.
+  std::vector<std::vector<std::pair<int, int>>> pairs(outputs.size());
+  auto result = shared_build_probe(
+      ht, R.size, S.size, options,
+      [&](size_t begin, size_t end) {
+        for (size_t row = begin; row < end; ++row) {
+          ht.Insert(R.keys[row], R.payload(row));
+        }
+      },
+      [&](int i, size_t begin, size_t end, size_t& matches) {
+        auto& out = outputs[i];
+        return ht.ProbeKeys(S.keys + begin, end - begin,
+                            [&](size_t row, int value_r) {
+                              int value_s = S.payload(begin + row);
+                              ++matches;
+                              if (options.sink != nullptr) {
+                                emit_to_sink(options.sink, i, pairs[i],
+                                             {value_r, value_s});
+                              } else {
+                                out.r_values.push_back(value_r);
+                                out.s_values.push_back(value_s);
+                              }
+                            });
+      },
+      [&](int i) { flush_to_sink(options.sink, i, pairs[i], 0); },
+      [&] {
+        JoinStats* stats = options.stats;
+        PhaseTimer merge_timer(stats ? &stats->merge : nullptr, 1,
+                               options.perf_counters);
+        merge_timer.ThreadStart(0);
+        ColumnarResult merged;
+        size_t total = 0;
+        for (auto& out : outputs) {
+          total += out.size();
+        }
+        merged.r_values.reserve(total);
+        merged.s_values.reserve(total);
+        for (auto& out : outputs) {
+          merged.r_values.insert(merged.r_values.end(), out.r_values.begin(),
+                                 out.r_values.end());
+          merged.s_values.insert(merged.s_values.end(), out.s_values.begin(),
+                                 out.s_values.end());
+        }
+        merge_timer.ThreadDone(0, total);
+        merge_timer.Finish();
+        return merged;
+      });
+  if (options.stats != nullptr) {
+    options.stats->bytes_allocated += 2 * result.size() * sizeof(int);
+  }
+  return result;
+}
+
+auto to_pairs(const ColumnarRelation& rel)
+    -> std::vector<std::pair<int, int>> {
+  std::vector<std::pair<int, int>> pairs(rel.size);
+  for (size_t row = 0; row < rel.size; ++row) {
+    pairs[row] = {rel.keys[row], rel.payload(row)};
+  }
+  return pairs;
+}
+
+auto join_as_pairs(const ColumnarRelation& R, const ColumnarRelation& S,
+                   const JoinOptions& options) -> ColumnarResult {
+  auto pairs = multi_threaded_hash_join(to_pairs(R), to_pairs(S), options);
+  ColumnarResult result;
+  result.r_values.reserve(pairs.size());
+  result.s_values.reserve(pairs.size());
+  for (const auto& p : pairs) {
+    result.r_values.push_back(p.first);
+    result.s_values.push_back(p.second);
+  }
+  return result;
+}
+
+}  // namespace
+
+auto multi_threaded_hash_join(const ColumnarRelation& R,
+                              const ColumnarRelation& S,
+                              const JoinOptions& options) -> ColumnarResult {
+  if (options.join_type != JoinType::kInner) {
+    // Semi, anti and outer rows do not pair up R and S values in place.
+    return join_as_pairs(R, S, options);
+  }
+  switch (options.algorithm) {
+    case JoinAlgorithm::kSharedHashTable: {
+      HashTable ht(options.table_size, options.key_size, 0.01,
+                   options.huge_pages);
+      ht.SetMaxLoadFactor(options.max_load_factor);
+      return columnar_shared_join(ht, R, S, options);
+    }
+    case JoinAlgorithm::kLockFreeHashTable: {
+      ConcurrentHashTable ht(R.size);
+      return columnar_shared_join(ht, R, S, options);
+    }
+    default:
+      // Partitioning and sorting move whole tuples, so interleave once.
+      return join_as_pairs(R, S, options);
+  }
+}
+
+}  // namespace hashjoin
@@ -0,0 +1,139 @@
+#include "concurrent_hash_table.h"
+
+#include <stdexcept>
+
+namespace hashjoin {
+
+ConcurrentHashTable::ConcurrentHashTable(size_t capacity)
+    : nodes_(new Node[capacity > 0 ? capacity : 1]), capacity_(capacity) {
+  // One bucket per tuple, rounded up to a power of two.
+  num_buckets_ = 16;
+  bits_ = 4;
+  while (num_buckets_ < capacity) {
+    num_buckets_ <<= 1;
+    ++bits_;
+  }
+  heads_.reset(new std::atomic<uint32_t>[num_buckets_]);
+  for (size_t i = 0; i < num_buckets_; ++i) {
+    heads_[i].store(kEnd, std::memory_order_relaxed);
+  }
+}
+
+//-----------public--------------
+void ConcurrentHashTable::Insert(int key, int value) {
+  size_t idx = num_nodes_.fetch_add(1, std::memory_order_relaxed);
+  if (idx >= capacity_) {
+    // Give the slot back so size() still counts only stored tuples.
+    num_nodes_.fetch_sub(1, std::memory_order_relaxed);
+    throw std::length_error("ConcurrentHashTable: capacity exceeded");
+  }
+  auto& node = nodes_[idx];
+  node.key = key;
+  node.value = value;
+  auto& head = heads_[hash(key)];
+  uint32_t next = head.load(std::memory_order_relaxed);
+  do {
+    node.next = next;
+  } while (!head.compare_exchange_weak(next, static_cast<uint32_t>(idx),
+                                       std::memory_order_release,
+                                       std::memory_order_relaxed));
+}
+
+auto ConcurrentHashTable::Get(int key) const -> std::vector<int> {
+  std::vector<int> values;
+  ForEachMatch(key, [&](int value) { values.push_back(value); });
+  return values;
+}
+
+//-----------build---------------
+
+void ConcurrentHashTable::Build(std::vector<std::pair<int, int>>& kvs) {
+  for (auto& kv : kvs) {
+    Insert(kv.first, kv.second);
+  }
+}
+
+//-----------probe---------------
+
+auto ConcurrentHashTable::Probe(std::vector<std::pair<int, int>>& kvs)
+    -> std::vector<std::pair<int, int>> {
+  std::vector<std::pair<int, int>> result;
+  ProbeBatch(kvs.data(), kvs.size(), [&](int value_r, int value_s) {
+    result.push_back({value_r, value_s});
+  });
+  return result;
+}
+
+//-----------stats---------------
+
+auto ConcurrentHashTable::ChainLengthHistogram() const -> std::vector<size_t> {
+  std::vector<size_t> histogram;
+  for (size_t b = 0; b < num_buckets_; ++b) {
+    size_t length = 0;
+    for (uint32_t i = heads_[b].load(std::memory_order_acquire); i != kEnd;
+         i = nodes_[i].next) {
+      ++length;
+    }
+    if (length >= histogram.size()) {
+      histogram.resize(length + 1);
+    }
+    ++histogram[length];
+  }
+  return histogram;
+}
+
+//-----------key set---------------
+
+ConcurrentKeySet::ConcurrentKeySet(size_t capacity) {
+  // At least twice the capacity, rounded up to a power of two.
+  size_t num_slots = 16;
+  bits_ = 4;
+  while (num_slots < 2 * capacity) {
+    num_slots <<= 1;
+    ++bits_;
+  }
+  mask_ = num_slots - 1;
+  slots_.reset(new std::atomic<int>[num_slots]);
+  for (size_t i = 0; i < num_slots; ++i) {
+    slots_[i].store(kEmpty, std::memory_order_relaxed);
+  }
+}
+
+void ConcurrentKeySet::Insert(int key) {
+  if (key == kEmpty) {
+    has_empty_key_.store(true, std::memory_order_release);
+    return;
+  }
+  for (size_t i = probe_hash(key, bits_);; i = (i + 1) & mask_) {
+    int slot = slots_[i].load(std::memory_order_relaxed);
+    if (slot == kEmpty &&
+        slots_[i].compare_exchange_strong(slot, key,
+                                          std::memory_order_release,
+                                          std::memory_order_relaxed)) {
+      return;
+    }
+    // Either taken before or lost the CAS; `slot` holds the winner.
+    if (slot == key) {
+      return;
+    }
+  }
+}
+
+auto ConcurrentKeySet::ContainsBatch(const int* keys, size_t n,
+                                     uint32_t* sel) const -> size_t {
+  if (has_empty_key_.load(std::memory_order_acquire)) {
+    // The kernel never finds the marker key; rare enough to go scalar.
+    size_t count = 0;
+    for (size_t i = 0; i < n; ++i) {
+      sel[count] = static_cast<uint32_t>(i);
+      count += Contains(keys[i]);
+    }
+    return count;
+  }
+  static_assert(sizeof(std::atomic<int>) == sizeof(int),
+                "slots are read as a plain int array");
+  return find_keys(reinterpret_cast<const int*>(slots_.get()), bits_, kEmpty,
+                   keys, n, sel);
+}
+
+}  // namespace hashjoin
@@ -0,0 +1,8 @@
+#include "flat_hash_table.h"
+
+namespace hashjoin {
+
+// The int table is used all over; instantiate it once here.
+template class BasicFlatHashTable<int, int>;
+
+}  // namespace hashjoin
@@ -0,0 +1,189 @@
+#include "frozen_hash_table.h"
+
+#include <functional>
+
+#include "join_stats.h"
+#include "morsel_scheduler.h"
+#include "result_sink.h"
+#include "thread_pool.h"
+
+namespace hashjoin {
+
+FrozenHashTable::FrozenHashTable(const std::vector<std::pair<int, int>>& R,
+                                 const JoinOptions& options)
+    : num_values_(R.size()) {
+  int num_threads = join_threads(options);
+  ThreadPool* pool = options.pool;
+  JoinStats* stats = options.stats;
+  if (stats != nullptr) {
+    *stats = JoinStats();
+  }
+  PhaseTimer total_timer(nullptr, 0);
+  PhaseTimer build_timer(stats ? &stats->build : nullptr, num_threads,
+                         options.perf_counters);
+
+  // At least twice the tuples, rounded up to a power of two.
+  num_slots_ = 16;
+  bits_ = 4;
+  while (num_slots_ < 2 * R.size()) {
+    num_slots_ <<= 1;
+    ++bits_;
+  }
+  mask_ = num_slots_ - 1;
+  keys_.reset(new int[num_slots_]);
+  ranges_.reset(new Range[num_slots_ + 1]);
+  values_.reset(new int[R.size() > 0 ? R.size() : 1]);
+  // Each pass starts and stops the thread's counters: without a pool every
+  // run_parallel runs on new threads, and counters only count their own.
+  auto pass = [&](const std::function<size_t(int)>& body) {
+    run_parallel(pool, num_threads, [&](int i) {
+      build_timer.ThreadStart(i);
+      build_timer.ThreadDone(i, body(i));
+    });
+  };
+  MorselScheduler init_sched(num_slots_ + 1, num_threads);
+  pass([&](int i) -> size_t {
+    size_t begin, end;
+    while (init_sched.Next(i, begin, end)) {
+      std::fill(keys_.get() + begin, keys_.get() + std::min(end, num_slots_),
+                kEmpty);
+      std::fill(ranges_.get() + begin, ranges_.get() + end, Range{0, 0});
+    }
+    return 0;
+  });
+
+  // Pass 1: insert the keys and count the values of each.
+  std::vector<size_t> new_keys(num_threads, 0);
+  MorselScheduler count_sched(R.size(), num_threads);
+  pass([&](int i) -> size_t {
+    size_t begin, end;
+    while (count_sched.Next(i, begin, end)) {
+      for (size_t row = begin; row < end; ++row) {
+        size_t slot = insertKey(R[row].first);
+        if (__atomic_fetch_add(&ranges_[slot].count, 1, __ATOMIC_RELAXED) ==
+            0) {
+          ++new_keys[i];
+        }
+      }
+    }
+    return 0;
+  });
+
+  // Prefix sum over blocks of ranges; each begin is left at the end of its
+  // range so that pass 2 can claim positions by counting down.
+  size_t num_ranges = num_slots_ + 1;
+  size_t block = (num_ranges + num_threads - 1) / num_threads;
+  std::vector<uint32_t> block_sums(num_threads + 1, 0);
+  pass([&](int i) -> size_t {
+    size_t end = std::min(num_ranges, (i + 1) * block);
+    uint32_t sum = 0;
+    for (size_t r = std::min(num_ranges, i * block); r < end; ++r) {
+      sum += ranges_[r].count;
+    }
+    block_sums[i + 1] = sum;
+    return 0;
+  });
+  for (int i = 0; i < num_threads; ++i) {
+    block_sums[i + 1] += block_sums[i];
+  }
+  pass([&](int i) -> size_t {
+    size_t end = std::min(num_ranges, (i + 1) * block);
+    uint32_t offset = block_sums[i];
+    for (size_t r = std::min(num_ranges, i * block); r < end; ++r) {
+      offset += ranges_[r].count;
+      ranges_[r].begin = offset;
+    }
+    return 0;
+  });
+
+  // Pass 2: scatter the values into their ranges.
+  MorselScheduler scatter_sched(R.size(), num_threads);
+  pass([&](int i) -> size_t {
+    size_t begin, end, tuples = 0;
+    while (scatter_sched.Next(i, begin, end)) {
+      for (size_t row = begin; row < end; ++row) {
+        auto* range = const_cast<Range*>(find(R[row].first));
+        values_[__atomic_sub_fetch(&range->begin, 1, __ATOMIC_RELAXED)] =
+            R[row].second;
+      }
+      tuples += end - begin;
+    }
+    return tuples;
+  });
+  build_timer.Finish();
+  for (size_t keys : new_keys) {
+    num_keys_ += keys;
+  }
+  if (stats != nullptr) {
+    stats->bytes_allocated = size_in_bytes();
+    stats->total_ms = total_timer.ElapsedMs();
+  }
+}
+
+auto FrozenHashTable::insertKey(int key) -> size_t {
+  if (key == kEmpty) {
+    return num_slots_;
+  }
+  for (size_t i = probe_hash(key, bits_);; i = (i + 1) & mask_) {
+    int slot = __atomic_load_n(&keys_[i], __ATOMIC_RELAXED);
+    if (slot == kEmpty &&
+        __atomic_compare_exchange_n(&keys_[i], &slot, key, false,
+                                    __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+      return i;
+    }
+    // Either taken before or lost the CAS; `slot` holds the winner.
+    if (slot == key) {
+      return i;
+    }
+  }
+}
+
+auto FrozenHashTable::Probe(const std::vector<std::pair<int, int>>& S,
+                            const JoinOptions& options) const
+    -> std::vector<std::pair<int, int>> {
+  using Tuples = std::vector<std::pair<int, int>>;
+  int num_threads = join_threads(options);
+  JoinStats* stats = options.stats;
+  if (stats != nullptr) {
+    *stats = JoinStats();
+  }
+  PhaseTimer total_timer(nullptr, 0);
+  PhaseTimer probe_timer(stats ? &stats->probe : nullptr, num_threads,
+                         options.perf_counters);
+  MorselScheduler probe_sched(S.size(), num_threads);
+  std::vector<Tuples> outputs(num_threads);
+  std::vector<size_t> probed(num_threads, 0);
+  std::vector<size_t> matches(num_threads, 0);
+  run_parallel(options.pool, num_threads, [&](int i) {
+    probe_timer.ThreadStart(i);
+    auto& out = outputs[i];
+    size_t begin, end;
+    while (probe_sched.Next(i, begin, end)) {
+      ProbeBatch(
+          S.data() + begin, end - begin,
+          [&](int value_r, int value_s) {
+            emit_to_sink(options.sink, i, out, {value_r, value_s});
+            ++matches[i];
+          },
+          options.prefetch);
+      probed[i] += end - begin;
+    }
+    flush_to_sink(options.sink, i, out, 0);
+    probe_timer.ThreadDone(i, probed[i]);
+  });
+  probe_timer.Finish();
+
+  // Merge results
+  Tuples final_output = merge_outputs(outputs, options);
+  if (stats != nullptr) {
+    for (size_t count : matches) {
+      stats->match_count += count;
+    }
+    stats->bytes_allocated =
+        final_output.capacity() * sizeof(final_output[0]);
+    stats->total_ms = total_timer.ElapsedMs();
+  }
+  return final_output;
+}
+
+}  // namespace hashjoin
@@ -0,0 +1,347 @@
+#include "grace_hash_join.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <memory>
+#include <string>
+#include <system_error>
+
+#include "hashjoin.h"
+#include "morsel_scheduler.h"
+
+namespace hashjoin {
+
+namespace {
+
+using Tuple = std::pair<int, int>;
+using Tuples = std::vector<Tuple>;
+
+// Bytes a build tuple costs in a level's HashTable: up to one 64-byte
+// Bucket per tuple (the table gets resident / 2 + 1 buckets, rounded up to a
+// power of two), its 24-byte Entry in an arena array that grows by doubling
+// and leaves the old copies behind (about 32 bytes a key), and a 4-byte
+// payload slot. Distinct keys measure 70 to 98 bytes a tuple.
+constexpr size_t kBuildTupleBytes = 100;
+// Partition bits per level; each level uses the next bits of the hash.
+constexpr int kMaxFanoutBits = 6;
+constexpr int kMaxLevels = 64 / kMaxFanoutBits;
+
+inline auto grace_hash(int key) -> uint64_t {
+  uint64_t h = static_cast<uint32_t>(key);
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+/**
+ * Anonymous file of tuples, unlinked on creation so it goes away with the
+ * process. Appends are buffered.
+ */
+class SpillFile {
+ public:
+  explicit SpillFile(const char* dir) {
+    if (dir == nullptr) {
+      file_ = std::tmpfile();
+    } else {
+      std::string path = std::string(dir) + "/hashjoin-spill-XXXXXX";
+      int fd = mkstemp(&path[0]);
+      if (fd >= 0) {
+        unlink(path.c_str());
+        file_ = fdopen(fd, "w+b");
+        if (file_ == nullptr) {
+          close(fd);
+        }
+      }
+    }
+    if (file_ == nullptr) {
+      throw std::system_error(errno, std::generic_category(),
+                              "cannot create spill file");
+    }
+    buffer_.reserve(SPILL_BUFFER_SIZE);
+  }
+  ~SpillFile() { std::fclose(file_); }
+  SpillFile(const SpillFile&) = delete;
+  auto operator=(const SpillFile&) -> SpillFile& = delete;
+
+  void Append(const Tuple& tuple) {
+    buffer_.push_back(tuple);
+    if (buffer_.size() == SPILL_BUFFER_SIZE) {
+      flush();
+    }
+    ++size_;
+  }
+
+  /**
+   * Calls `fn(tuples, n)` for every chunk of the file, in order.
+   */
+  template <typename Fn>
+  void ForEachChunk(Fn&& fn) {
+    flush();
+    std::rewind(file_);
+    Tuples chunk(SPILL_CHUNK_SIZE);
+    size_t n;
+    while ((n = std::fread(chunk.data(), sizeof(Tuple), chunk.size(),
+                           file_)) > 0) {
+      fn(chunk.data(), n);
+    }
+    std::fseek(file_, 0, SEEK_END);
+  }
+
+  auto size() const -> size_t { return size_; }
+
+ private:
+  void flush() {
+    if (!buffer_.empty() && std::fwrite(buffer_.data(), sizeof(Tuple),
+                                        buffer_.size(),
+                                        file_) != buffer_.size()) {
+      throw std::system_error(errno, std::generic_category(),
+                              "cannot write spill file");
+    }
+    buffer_.clear();
+  }
+
+  std::FILE* file_ = nullptr;
+  Tuples buffer_;
+  size_t size_ = 0;
+};
+
+/**
+ * One side of a partition pair: the caller's vector at the top level, a
+ * spill file below it.
+ */
+struct Input {
+  const Tuples* tuples;
+  SpillFile* file;
+
+  auto size() const -> size_t {
+    return tuples != nullptr ? tuples->size() : file->size();
+  }
+  template <typename Fn>
+  void ForEachChunk(Fn&& fn) const {
+    if (file != nullptr) {
+      file->ForEachChunk(fn);
+      return;
+    }
+    for (size_t base = 0; base < tuples->size(); base += SPILL_CHUNK_SIZE) {
+      fn(tuples->data() + base,
+         std::min<size_t>(SPILL_CHUNK_SIZE, tuples->size() - base));
+    }
+  }
+};
+
+struct GraceContext {
+  const JoinOptions& options;
+  int num_threads;
+  size_t budget_tuples;
+  std::vector<Tuples> outputs;
+  GraceStats stats;
+  // Only kept when options.stats is set.
+  std::vector<ProbeCounts> counts;
+  std::vector<size_t> matches;
+  size_t peak_bytes = 0;
+};
+
+/**
+ * Joins R and S at one partitioning level. With `in_memory` set, or when R
+ * fits the budget, every partition stays resident and nothing is spilled.
+ */
+void grace_level(GraceContext& ctx, const Input& R, const Input& S, int level,
+                 bool in_memory) {
+  in_memory = in_memory || R.size() <= ctx.budget_tuples;
+  // Aim for partitions of half the budget so that some of them stay.
+  int bits = 0;
+  while (!in_memory && bits < kMaxFanoutBits &&
+         (R.size() >> bits) > ctx.budget_tuples / 2) {
+    ++bits;
+  }
+  size_t fanout = size_t{1} << bits;
+  int shift = level * kMaxFanoutBits;
+  auto partition_of = [&](int key) -> size_t {
+    return (grace_hash(key) >> shift) & (fanout - 1);
+  };
+  ctx.stats.max_depth = std::max(ctx.stats.max_depth, level);
+
+  // Partition R, spilling the largest resident partition while over budget.
+  std::vector<Tuples> resident(fanout);
+  std::vector<std::unique_ptr<SpillFile>> r_files(fanout);
+  std::vector<std::unique_ptr<SpillFile>> s_files(fanout);
+  size_t resident_tuples = 0;
+  R.ForEachChunk([&](const Tuple* tuples, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+      size_t p = partition_of(tuples[i].first);
+      if (r_files[p] != nullptr) {
+        r_files[p]->Append(tuples[i]);
+        continue;
+      }
+      resident[p].push_back(tuples[i]);
+      if (++resident_tuples > ctx.budget_tuples && !in_memory) {
+        size_t victim = 0;
+        for (size_t q = 1; q < fanout; ++q) {
+          if (resident[q].size() > resident[victim].size()) {
+            victim = q;
+          }
+        }
+        r_files[victim].reset(new SpillFile(ctx.options.spill_dir));
+        for (const auto& kv : resident[victim]) {
+          r_files[victim]->Append(kv);
+        }
+        resident_tuples -= resident[victim].size();
+        Tuples().swap(resident[victim]);
+      }
+    }
+  });
+
+  {
+    // Build one table over every resident partition.
+    HashTable ht(std::max(ctx.options.table_size, resident_tuples / 2 + 1),
+                 resident_tuples, 0.01, ctx.options.huge_pages);
+    ht.SetPrefetch(ctx.options.prefetch);
+    run_parallel(ctx.options.pool, ctx.num_threads, [&](int i) {
+      for (size_t p = i; p < fanout; p += ctx.num_threads) {
+        for (const auto& kv : resident[p]) {
+          ht.Insert(kv.first, kv.second);
+        }
+        Tuples().swap(resident[p]);
+      }
+    });
+
+    // Probes `tuples` in one parallel pass, morsel by morsel.
+    auto probe = [&](const Tuples& tuples) {
+      if (resident_tuples == 0 || tuples.empty()) {
+        return;
+      }
+      MorselScheduler probe_sched(tuples.size(), ctx.num_threads);
+      run_parallel(ctx.options.pool, ctx.num_threads, [&](int i) {
+        size_t begin, end;
+        while (probe_sched.Next(i, begin, end)) {
+          auto counts = probe_thread(tuples, begin, end, ht, ctx.outputs[i],
+                                     ctx.options.sink, i);
+          if (ctx.options.stats != nullptr) {
+            ctx.counts[i] += counts;
+            ctx.matches[i] += counts.matches;
+          }
+        }
+      });
+    };
+    size_t batch_bytes = 0;
+    bool any_spilled = std::any_of(
+        r_files.begin(), r_files.end(),
+        [](const std::unique_ptr<SpillFile>& file) { return file != nullptr; });
+    if (S.tuples != nullptr && !any_spilled) {
+      // Everything is resident: probe the caller's S in place.
+      probe(*S.tuples);
+    } else {
+      // Probe S against it, spilling the tuples of spilled partitions. The
+      // resident ones are gathered over many chunks, so that the threads
+      // meet once per batch, not once per chunk. The batch is charged to
+      // the budget next to the table, down to a spill buffer's worth.
+      size_t batch_limit = GRACE_PROBE_BATCH_SIZE;
+      if (ctx.options.memory_budget != 0) {
+        size_t table_bytes = ht.size_in_bytes();
+        size_t left = ctx.options.memory_budget > table_bytes
+                          ? ctx.options.memory_budget - table_bytes
+                          : 0;
+        batch_limit = std::min(
+            batch_limit,
+            std::max<size_t>(SPILL_BUFFER_SIZE, left / sizeof(Tuple)));
+      }
+      Tuples batch;
+      batch.reserve(batch_limit);
+      S.ForEachChunk([&](const Tuple* tuples, size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+          size_t p = partition_of(tuples[i].first);
+          if (r_files[p] == nullptr) {
+            batch.push_back(tuples[i]);
+            if (batch.size() >= batch_limit) {
+              probe(batch);
+              batch.clear();
+            }
+            continue;
+          }
+          if (s_files[p] == nullptr) {
+            s_files[p].reset(new SpillFile(ctx.options.spill_dir));
+          }
+          s_files[p]->Append(tuples[i]);
+        }
+      });
+      probe(batch);
+      batch_bytes = batch.capacity() * sizeof(Tuple);
+    }
+    if (ctx.options.stats != nullptr) {
+      ctx.peak_bytes =
+          std::max(ctx.peak_bytes, ht.size_in_bytes() + batch_bytes);
+    }
+  }
+
+  // Join the spilled partition pairs one level down.
+  for (size_t p = 0; p < fanout; ++p) {
+    if (r_files[p] == nullptr || s_files[p] == nullptr) {
+      continue;
+    }
+    ++ctx.stats.spilled_partitions;
+    ctx.stats.spilled_tuples += r_files[p]->size() + s_files[p]->size();
+    // No progress means one key (or hash) holds the whole partition.
+    bool stuck = r_files[p]->size() == R.size() || level + 1 >= kMaxLevels;
+    grace_level(ctx, Input{nullptr, r_files[p].get()},
+                Input{nullptr, s_files[p].get()}, level + 1, stuck);
+    r_files[p].reset();
+    s_files[p].reset();
+  }
+}
+
+}  // namespace
+
+auto grace_hash_join(const std::vector<std::pair<int, int>>& R,
+                     const std::vector<std::pair<int, int>>& S,
+                     const JoinOptions& options)
+    -> std::vector<std::pair<int, int>> {
+  JoinStats* stats = options.stats;
+  if (stats != nullptr) {
+    *stats = JoinStats();
+  }
+  PhaseTimer total_timer(nullptr, 0);
+  int num_threads = join_threads(options);
+  size_t budget_tuples =
+      options.memory_budget == 0
+          ? std::numeric_limits<size_t>::max()
+          : std::max<size_t>(1, options.memory_budget / kBuildTupleBytes);
+  GraceContext ctx{options, num_threads, budget_tuples,
+                   std::vector<Tuples>(num_threads), GraceStats()};
+  if (stats != nullptr) {
+    ctx.counts.resize(num_threads);
+    ctx.matches.resize(num_threads);
+  }
+  grace_level(ctx, Input{&R, nullptr}, Input{&S, nullptr}, 0, false);
+
+  // Merge results
+  for (int i = 0; i < num_threads; ++i) {
+    flush_to_sink(options.sink, i, ctx.outputs[i], 0);
+  }
+  auto final_output = merge_outputs(ctx.outputs, options);
+  if (options.grace_stats != nullptr) {
+    *options.grace_stats = ctx.stats;
+  }
+  if (stats != nullptr) {
+    ProbeCounts total;
+    for (int i = 0; i < num_threads; ++i) {
+      total += ctx.counts[i];
+      stats->match_count += ctx.matches[i];
+    }
+    record_probe_counts(stats, total);
+    // Levels run one after another, so the largest table is the peak.
+    stats->bytes_allocated =
+        ctx.peak_bytes + final_output.capacity() * sizeof(final_output[0]);
+    stats->total_ms = total_timer.ElapsedMs();
+  }
+  return final_output;
+}
+
+}  // namespace hashjoin
@@ -1,23 +1,52 @@
 #include "hashjoin.h"
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <thread>
+
+#include "morsel_scheduler.h"
+
 namespace hashjoin {
 
 //-----------public--------------
 void HashTable::Insert(int key, int value) {
 #ifdef BLOOM_FILTER_ENABLE
-  //std::lock_guard<std::mutex> blm_lock(blm_mtx);
   blm_.insert(key);
 #endif
-  auto& bucket = buckets[hash(key)];
-  // Lock the bucket.
-  std::lock_guard<std::mutex> lock(bucket.mtx);
-  for (auto& entry : bucket.entries) {
-    if (entry.first == key) {
-      entry.second.push_back(value);
-      return;
+  for (;;) {
+    BucketArray* table = current_.load(std::memory_order_acquire);
+    BucketArray* old = old_.load(std::memory_order_acquire);
+    if (old != nullptr && old != table) {
+      helpRehash(old, table, REHASH_BUCKETS_PER_INSERT);
+      // Until the rehash reaches it, the key's old bucket takes its tuples,
+      // so that a key never has entries in both arrays.
+      auto& src = old->bucket(key);
+      std::unique_lock<std::mutex> lock(src.mtx);
+      if (!src.migrated.load(std::memory_order_acquire)) {
+        bool added = insertLocked(src, key, value);
+        lock.unlock();
+        if (added) {
+          keyAdded(table);
+        }
+        return;
+      }
+    }
+    auto& bucket = table->bucket(key);
+    // Lock the bucket.
+    std::unique_lock<std::mutex> lock(bucket.mtx);
+    if (bucket.migrated.load(std::memory_order_acquire)) {
+      // The table grew since `table` was read.
+      continue;
+    }
+    bool added = insertLocked(bucket, key, value);
+    lock.unlock();
+    if (added) {
+      keyAdded(table);
     }
+    return;
   }
-  bucket.entries.push_back({key, {value}});
 }
 auto HashTable::Get(int key) const -> std::vector<int> {
 #ifdef BLOOM_FILTER_ENABLE
@@ -26,14 +55,167 @@ auto HashTable::Get(int key) const -> std::vector<int> {
     return std::vector<int>();
   }
 #endif
-  auto& bucket = buckets[hash(key)];
-  for (const auto& entry : bucket.entries) {
-    if (entry.first == key) {
-      return entry.second;
+  std::unique_lock<std::mutex> lock;
+  for (const auto& entry : lockedBucketOf(key, lock)) {
+    if (entry.key == key) {
+      return std::vector<int>(entry.begin(), entry.end());
     }
   }
   return std::vector<int>();
 }
+auto HashTable::Contains(int key) const -> bool {
+#ifdef BLOOM_FILTER_ENABLE
+  if (!blm_.contains(key)) {
+    return false;
+  }
+#endif
+  std::unique_lock<std::mutex> lock;
+  for (const auto& entry : lockedBucketOf(key, lock)) {
+    if (entry.key == key) {
+      return true;
+    }
+  }
+  return false;
+}
+
+auto HashTable::lockedBucketOf(int key,
+                               std::unique_lock<std::mutex>& lock) const
+    -> const Bucket& {
+  for (;;) {
+    const Bucket& bucket = bucketOf(key);
+    lock = std::unique_lock<std::mutex>(bucket.mtx);
+    // A rehash may have moved it before the lock was taken.
+    if (!bucket.migrated.load(std::memory_order_acquire)) {
+      return bucket;
+    }
+    lock.unlock();
+  }
+}
+//-----------growth---------------
+
+auto HashTable::insertLocked(Bucket& bucket, int key, int value) -> bool {
+  for (uint32_t i = 0; i < bucket.size; ++i) {
+    auto& entry = bucket.entries[i];
+    if (entry.key == key) {
+      if (entry.size == entry.capacity) {
+        entry.values = arena_.Local().GrowArray(entry.values, entry.size,
+                                                entry.capacity * 2);
+        entry.capacity *= 2;
+      }
+      entry.values[entry.size++] = value;
+      return false;
+    }
+  }
+  int* values = arena_.Local().AllocateArray<int>(1);
+  values[0] = value;
+  appendEntry(bucket, Entry{key, 1, 1, 0, values});
+  return true;
+}
+
+void HashTable::keyAdded(BucketArray* table) {
+  if (max_load_factor_ > 0 &&
+      static_cast<double>(num_keys_.fetch_add(1, std::memory_order_relaxed) +
+                          1) > max_load_factor_ * table->size()) {
+    grow(table);
+  }
+}
+
+void HashTable::appendEntry(Bucket& bucket, const Entry& entry) {
+  if (bucket.size == bucket.capacity) {
+    uint32_t capacity =
+        bucket.capacity == 0 ? kInitialEntries : bucket.capacity * 2;
+    bucket.entries =
+        arena_.Local().GrowArray(bucket.entries, bucket.size, capacity);
+    bucket.capacity = capacity;
+  }
+  bucket.entries[bucket.size++] = entry;
+}
+
+void HashTable::migrate(BucketArray* from, BucketArray* to, size_t b) {
+  Bucket& src = from->buckets[b];
+  std::lock_guard<std::mutex> lock(src.mtx);
+  if (src.migrated.load(std::memory_order_acquire)) {
+    return;
+  }
+  // The hash takes the top bits, so `src` splits into buckets 2b and 2b + 1
+  // of `to`. Nothing else touches those before `src` is flagged: inserts
+  // for their keys go to `src` under its lock until then. Both start empty
+  // and get entry arrays of the exact size.
+  Bucket* dst = &to->buckets[2 * b];
+  uint32_t counts[2] = {0, 0};
+  for (const auto& entry : src) {
+    ++counts[probe_hash(entry.key, to->bits) & 1];
+  }
+  for (int half = 0; half < 2; ++half) {
+    if (counts[half] > 0) {
+      dst[half].capacity = std::max(counts[half], kInitialEntries);
+      dst[half].entries =
+          arena_.Local().AllocateArray<Entry>(dst[half].capacity);
+    }
+  }
+  for (const auto& entry : src) {
+    Bucket& half = dst[probe_hash(entry.key, to->bits) & 1];
+    half.entries[half.size++] = entry;
+  }
+  // After the entries: unlocked readers go by the flag alone.
+  src.migrated.store(true, std::memory_order_release);
+}
+
+void HashTable::helpRehash(BucketArray* from, BucketArray* to, size_t n) {
+  size_t begin = from->cursor.fetch_add(n, std::memory_order_relaxed);
+  if (begin >= from->size()) {
+    return;
+  }
+  size_t end = std::min(begin + n, from->size());
+  for (size_t b = begin; b < end; ++b) {
+    migrate(from, to, b);
+  }
+  if (from->moved.fetch_add(end - begin, std::memory_order_acq_rel) +
+          (end - begin) ==
+      from->size()) {
+    // The last buckets have moved.
+    old_.store(nullptr, std::memory_order_release);
+  }
+}
+
+void HashTable::grow(BucketArray* full) {
+  std::lock_guard<std::mutex> lock(grow_mtx_);
+  // Someone grew it already, or a rehash is still pending.
+  if (current_.load(std::memory_order_relaxed) != full ||
+      old_.load(std::memory_order_relaxed) != nullptr) {
+    return;
+  }
+  arrays_.emplace_back(new BucketArray(full->bits + 1));
+  // old_ first: a thread that sees the new array also sees the old one.
+  old_.store(full, std::memory_order_release);
+  current_.store(arrays_.back().get(), std::memory_order_release);
+}
+
+void HashTable::FinishRehash() {
+  for (;;) {
+    BucketArray* old = old_.load(std::memory_order_acquire);
+    BucketArray* table = current_.load(std::memory_order_acquire);
+    if (old == nullptr) {
+      // Keys that arrived during the last rehash may call for another.
+      if (max_load_factor_ > 0 &&
+          static_cast<double>(num_keys_.load(std::memory_order_relaxed)) >
+              max_load_factor_ * table->size()) {
+        grow(table);
+        continue;
+      }
+      return;
+    }
+    if (old == table || old->cursor.load(std::memory_order_relaxed) >=
+                            old->size()) {
+      // Being set up, or the last buckets are still moving elsewhere.
+      std::this_thread::yield();
+      continue;
+    }
+    // Larger steps; there are no inserts to spread them over.
+    helpRehash(old, table, 1024);
+  }
+}
+
 //-----------build---------------
 
 void HashTable::Build(std::vector<std::pair<int, int>>& kvs) {
@@ -42,36 +224,70 @@ void HashTable::Build(std::vector<std::pair<int, int>>& kvs) {
   }
 }
 
+void HashTable::Build(const ColumnarRelation& rel) {
+  for (size_t i = 0; i < rel.size; ++i) {
+    Insert(rel.keys[i], rel.payload(i));
+  }
+}
+
 //-----------probe---------------
 
 auto HashTable::Probe(std::vector<std::pair<int, int>>& kvs)
     -> std::vector<std::pair<int, int>> {
   std::vector<std::pair<int, int>> result;
-  for (auto& kv : kvs) {
-    int key = kv.first;
-    auto values_r = Get(key);  // Get the values from R table
-    for (int value_r : values_r) {
-      result.push_back({value_r, kv.second});
-    }
-    // if (blm_.contains(key)) {
-    //   auto values_r = Get(key);  // Get the values from R table
-    //   for (int value_r : values_r) {
-    //     result.push_back({value_r, kv.second});
-    //   }
-    // }
-  }
+  // Visit the values from R table in place.
+  ProbeBatch(kvs.data(), kvs.size(), [&](int value_r, int value_s) {
+    result.push_back({value_r, value_s});
+  });
+  return result;
+}
+
+auto HashTable::Probe(const ColumnarRelation& rel) -> ColumnarResult {
+  ColumnarResult result;
+  ProbeKeys(rel.keys, rel.size, [&](size_t row, int value_r) {
+    result.r_values.push_back(value_r);
+    result.s_values.push_back(rel.payload(row));
+  });
   return result;
 }
 
 //-----------utils---------------
-auto HashTable::hash(int key) const -> size_t {
-  size_t hash_value = std::hash<int>{}(key);
-  return hash_value % buckets.size();
+auto HashTable::getCollisionCount(size_t bucket) const -> size_t {
+  return current_.load(std::memory_order_acquire)->buckets[bucket].size;
 }
 
-auto HashTable::getCollisionCount(int key) -> size_t {
-  auto& bucket = buckets[hash(key)];
-  return bucket.entries.size();
+//-----------stats---------------
+auto HashTable::ChainLengthHistogram() const -> std::vector<size_t> {
+  std::vector<size_t> histogram;
+  for (size_t b = 0; b < num_buckets(); ++b) {
+    size_t length = getCollisionCount(b);
+    if (length >= histogram.size()) {
+      histogram.resize(length + 1);
+    }
+    ++histogram[length];
+  }
+  return histogram;
+}
+
+auto HashTable::first_chunk(size_t key_size) -> size_t {
+  // An entry and its first payload per key.
+  size_t bytes = key_size * (sizeof(Entry) + sizeof(int));
+  bytes /= std::max(1u, std::thread::hardware_concurrency());
+  return std::min<size_t>(std::max<size_t>(bytes, ARENA_MIN_CHUNK_SIZE),
+                          ARENA_CHUNK_SIZE);
+}
+
+auto HashTable::size_in_bytes() const -> size_t {
+  // Arena bytes handed out, not the untouched tails of their chunks.
+  // Old bucket arrays are counted too: they stay mapped after a rehash.
+  size_t bytes = arena_.bytes_used();
+  for (const auto& array : arrays_) {
+    bytes += array->size() * sizeof(Bucket);
+  }
+#ifdef BLOOM_FILTER_ENABLE
+  bytes += blm_.size_in_bytes();
+#endif
+  return bytes;
 }
 
 //---------muti-thread---------------
@@ -84,85 +300,479 @@ void build_thread(const std::vector<std::pair<int, int>>& R, int start, int end,
   }
 }
 
-void probe_thread(const std::vector<std::pair<int, int>>& S, int start, int end,
-                  const HashTable& ht,
-                  std::vector<std::pair<int, int>>& output) {
+auto probe_thread(const std::vector<std::pair<int, int>>& S, int start,
+                  int end, const HashTable& ht,
+                  std::vector<std::pair<int, int>>& output, ResultSink* sink,
+                  int thread_id) -> ProbeCounts {
+  size_t matches = 0;
+  ProbeCounts counts = ht.ProbeBatch(
+      S.data() + start, end - start, [&](int value_r, int value_s) {
+        emit_to_sink(sink, thread_id, output, {value_r, value_s});
+        ++matches;
+      });
+  counts.matches = matches;
+  return counts;
+}
+
+void finish_build_thread(HashTable& ht) { ht.FinishRehash(); }
+
+void build_thread(const std::vector<std::pair<int, int>>& R, int start, int end,
+                  ConcurrentHashTable& ht) {
   for (int i = start; i < end; ++i) {
-    int key = S[i].first;
-    int value_s = S[i].second;
-    auto values_r = ht.Get(key);
-    for (int value_r : values_r) {
-      output.push_back({value_r, value_s});
-    }
+    ht.Insert(R[i].first, R[i].second);
   }
 }
 
+void finish_build_thread(ConcurrentHashTable&) {}
+
+auto probe_thread(const std::vector<std::pair<int, int>>& S, int start,
+                  int end, const ConcurrentHashTable& ht,
+                  std::vector<std::pair<int, int>>& output, ResultSink* sink,
+                  int thread_id) -> ProbeCounts {
+  ProbeCounts counts;
+  counts.probed = counts.passed = end - start;
+  counts.found = ht.ProbeBatch(
+      S.data() + start, end - start, [&](int value_r, int value_s) {
+        emit_to_sink(sink, thread_id, output, {value_r, value_s});
+        ++counts.matches;
+      });
+  return counts;
+}
+
+namespace {
+
+/**
+ * Builds one table shared by all threads from R, then probes it with S.
+ * `Table` needs a thread-safe Insert and matching build_thread/probe_thread.
+ */
+template <typename Table>
+auto shared_table_join(Table& ht, const std::vector<std::pair<int, int>>& R,
+                       const std::vector<std::pair<int, int>>& S,
+                       const JoinOptions& options)
+    -> std::vector<std::pair<int, int>> {
+  std::vector<std::vector<std::pair<int, int>>> outputs(
+      join_threads(options));
+  auto result = shared_build_probe(
+      ht, R.size(), S.size(), options,
+      [&](size_t begin, size_t end) { build_thread(R, begin, end, ht); },
+      [&](int i, size_t begin, size_t end, size_t& matches) {
+        ProbeCounts counts =
+            probe_thread(S, begin, end, ht, outputs[i], options.sink, i);
+        matches += counts.matches;
+        return counts;
+      },
+      [&](int i) { flush_to_sink(options.sink, i, outputs[i], 0); },
+      [&] { return merge_outputs(outputs, options); });
+  if (options.stats != nullptr) {
+    options.stats->bytes_allocated += result.capacity() * sizeof(result[0]);
+  }
+  return result;
+}
+
+}  // namespace
+
 auto multi_threaded_hash_join(const std::vector<std::pair<int, int>>& R,
                               const std::vector<std::pair<int, int>>& S,
-                              int num_threads, size_t table_size, size_t key_size)
+                              int num_threads, size_t table_size, size_t key_size,
+                              ThreadPool* pool)
     -> std::vector<std::pair<int, int>> {
-  HashTable ht(table_size, key_size);
-  std::vector<std::thread> threads;
-#ifdef TIME_ENABLE
-  auto start = std::chrono::high_resolution_clock::now();
-#endif
-  // Build
-  int N = R.size();
-  int process_num = N / num_threads;
-
-  for (int i = 0; i < num_threads; ++i) {
-    int start = i * process_num;
-    int end = (i + 1) * process_num;
-    if (i == num_threads - 1) {
-      end = N;  // 最后一个线程处理剩余的元素
-    }
-    threads.emplace_back(build_thread, std::ref(R), start, end, std::ref(ht));
-  }
-  for (auto& t : threads) {
-    t.join();
-  }
-#ifdef TIME_ENABLE
-  auto end = std::chrono::high_resolution_clock::now();
-  auto duration =
-      std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
-  std::cout << "Build time: " << duration.count() << " ms\n";
-#endif
+  JoinOptions options;
+  options.num_threads = num_threads;
+  options.table_size = table_size;
+  options.key_size = key_size;
+  options.pool = pool;
+  return multi_threaded_hash_join(R, S, options);
+}
 
-#ifdef TIME_ENABLE
-  auto probe_start = std::chrono::high_resolution_clock::now();
-#endif
-  // Probe
-  threads.clear();
-  int M = S.size();
-  std::vector<std::vector<std::pair<int, int>>> outputs(num_threads);
-  for (int i = 0; i < num_threads; ++i) {
-    int start = i * process_num;
-    int end = (i + 1) * process_num;
-    if (i == num_threads - 1) {
-      end = M;
+//---------radix-partitioned---------------
+namespace {
+
+using Tuple = std::pair<int, int>;
+using Tuples = std::vector<Tuple>;
+
+// Bytes one R tuple takes in a partition's table: the tuple itself plus its
+// bucket head and chain link.
+constexpr size_t kPartitionTupleBytes = sizeof(std::pair<int, int>) + 2 * sizeof(int);
+
+// Murmur3 finalizer, so both the radix bits and the bucket bits above them
+// are well mixed.
+inline auto radix_hash(int key) -> uint64_t {
+  uint64_t h = static_cast<uint32_t>(key);
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+/**
+ * First pass: split the whole input on hash bits [shift, shift + bits) with
+ * all threads. Every thread histograms its own range and then scatters into
+ * a private slice of each partition, so no two threads write the same slot.
+ * @param offsets Filled with the 2^bits + 1 partition boundaries of `out`.
+ * @param place Called with `offsets` before the scatter first touches `out`.
+ * @param timer Bracketed around each thread's share of both passes.
+ */
+void radix_partition(const Tuple* in, size_t N, Tuple* out, int shift,
+                     int bits, int num_threads, ThreadPool* pool,
+                     std::vector<size_t>& offsets,
+                     const std::function<void(const std::vector<size_t>&)>&
+                         place,
+                     PhaseTimer& timer) {
+  size_t fanout = size_t{1} << bits;
+  uint64_t mask = fanout - 1;
+  size_t chunk = (N + num_threads - 1) / num_threads;
+  std::vector<std::vector<size_t>> hist(num_threads,
+                                        std::vector<size_t>(fanout, 0));
+  run_parallel(pool, num_threads, [&](int t) {
+    timer.ThreadStart(t);
+    size_t begin = std::min(N, t * chunk);
+    size_t end = std::min(N, begin + chunk);
+    for (size_t i = begin; i < end; ++i) {
+      ++hist[t][(radix_hash(in[i].first) >> shift) & mask];
+    }
+    timer.ThreadDone(t, 0);
+  });
+
+  // Partition-major, thread-minor prefix sum: hist becomes write cursors.
+  offsets.assign(fanout + 1, 0);
+  size_t sum = 0;
+  for (size_t p = 0; p < fanout; ++p) {
+    offsets[p] = sum;
+    for (int t = 0; t < num_threads; ++t) {
+      size_t count = hist[t][p];
+      hist[t][p] = sum;
+      sum += count;
+    }
+  }
+  offsets[fanout] = sum;
+  if (place) {
+    place(offsets);
+  }
+
+  run_parallel(pool, num_threads, [&](int t) {
+    timer.ThreadStart(t);
+    size_t begin = std::min(N, t * chunk);
+    size_t end = std::min(N, begin + chunk);
+    auto& cursor = hist[t];
+    for (size_t i = begin; i < end; ++i) {
+      out[cursor[(radix_hash(in[i].first) >> shift) & mask]++] = in[i];
+    }
+    timer.ThreadDone(t, end - begin);
+  });
+}
+
+/**
+ * Later passes: split every existing partition on the next `bits` hash bits.
+ * Partitions are independent, so threads pull whole partitions from a shared
+ * counter and sub-partition each one in place within its own range.
+ */
+void radix_refine(const Tuple* in, Tuple* out,
+                  const std::vector<size_t>& in_offsets, int shift, int bits,
+                  int num_threads, ThreadPool* pool,
+                  std::vector<size_t>& out_offsets, PhaseTimer& timer) {
+  size_t fanout = size_t{1} << bits;
+  uint64_t mask = fanout - 1;
+  size_t num_in = in_offsets.size() - 1;
+  out_offsets.assign(num_in * fanout + 1, 0);
+  out_offsets[num_in * fanout] = in_offsets[num_in];
+  std::atomic<size_t> next_partition{0};
+  run_parallel(pool, num_threads, [&](int t) {
+    timer.ThreadStart(t);
+    std::vector<size_t> cursor(fanout);
+    size_t p, tuples = 0;
+    while ((p = next_partition.fetch_add(1)) < num_in) {
+      size_t begin = in_offsets[p];
+      size_t end = in_offsets[p + 1];
+      std::fill(cursor.begin(), cursor.end(), 0);
+      for (size_t i = begin; i < end; ++i) {
+        ++cursor[(radix_hash(in[i].first) >> shift) & mask];
+      }
+      size_t sum = begin;
+      for (size_t j = 0; j < fanout; ++j) {
+        out_offsets[p * fanout + j] = sum;
+        size_t count = cursor[j];
+        cursor[j] = sum;
+        sum += count;
+      }
+      for (size_t i = begin; i < end; ++i) {
+        out[cursor[(radix_hash(in[i].first) >> shift) & mask]++] = in[i];
+      }
+      tuples += end - begin;
+    }
+    timer.ThreadDone(t, tuples);
+  });
+}
+
+/**
+ * Joins one partition pair with a bucket-chained table over the R side. The
+ * buckets are indexed by the hash bits above the radix bits, since every key
+ * in the partition shares the low ones. `bucket` and `next` are scratch
+ * buffers reused across partitions by the calling thread. Matches stream
+ * to `sink` every SINK_BATCH_SIZE pairs. Returns the number of matches.
+ */
+auto join_partition(const Tuple* R, size_t r_begin, size_t r_end,
+                    const Tuple* S, size_t s_begin, size_t s_end, int shift,
+                    std::vector<int>& bucket, std::vector<int>& next,
+                    Tuples& output, ResultSink* sink, int thread_id)
+    -> size_t {
+  size_t n = r_end - r_begin;
+  if (n == 0 || s_begin == s_end) {
+    return 0;
+  }
+  size_t matches = 0;
+  size_t num_buckets = 1;
+  while (num_buckets < n) {
+    num_buckets <<= 1;
+  }
+  uint64_t mask = num_buckets - 1;
+  bucket.assign(num_buckets, -1);
+  next.resize(n);
+  for (size_t i = 0; i < n; ++i) {
+    size_t b = (radix_hash(R[r_begin + i].first) >> shift) & mask;
+    next[i] = bucket[b];
+    bucket[b] = static_cast<int>(i);
+  }
+  for (size_t j = s_begin; j < s_end; ++j) {
+    int key = S[j].first;
+    size_t b = (radix_hash(key) >> shift) & mask;
+    for (int i = bucket[b]; i != -1; i = next[i]) {
+      if (R[r_begin + i].first == key) {
+        emit_to_sink(sink, thread_id, output,
+                     {R[r_begin + i].second, S[j].second});
+        ++matches;
+      }
+    }
+  }
+  return matches;
+}
+
+}  // namespace
+
+auto radix_hash_join(const std::vector<std::pair<int, int>>& R,
+                     const std::vector<std::pair<int, int>>& S,
+                     int num_threads, int radix_bits, int radix_passes,
+                     ThreadPool* pool, bool numa_aware, NumaStats* numa_stats)
+    -> std::vector<std::pair<int, int>> {
+  JoinOptions options;
+  options.algorithm = JoinAlgorithm::kRadixPartitioned;
+  options.num_threads = num_threads;
+  options.radix_bits = radix_bits;
+  options.radix_passes = radix_passes;
+  options.pool = pool;
+  options.numa_aware = numa_aware;
+  options.numa_stats = numa_stats;
+  return radix_hash_join(R, S, options);
+}
+
+auto radix_hash_join(const std::vector<std::pair<int, int>>& R,
+                     const std::vector<std::pair<int, int>>& S,
+                     const JoinOptions& options)
+    -> std::vector<std::pair<int, int>> {
+  int num_threads = std::max(join_threads(options), 1);
+  int radix_bits = options.radix_bits;
+  int radix_passes = options.radix_passes;
+  ThreadPool* pool = options.pool;
+  NumaStats* numa_stats = options.numa_stats;
+  JoinStats* stats = options.stats;
+  if (stats != nullptr) {
+    *stats = JoinStats();
+  }
+  PhaseTimer total_timer(nullptr, 0);
+  if (radix_bits <= 0) {
+    // Enough partitions that each R partition's table fits in L2, and at
+    // least one per thread.
+    size_t per_partition = L2_CACHE_SIZE / kPartitionTupleBytes;
+    radix_bits = 0;
+    while ((R.size() >> radix_bits) > per_partition ||
+           (size_t{1} << radix_bits) < static_cast<size_t>(num_threads)) {
+      ++radix_bits;
     }
-    threads.emplace_back(probe_thread, std::ref(S), start, end, std::ref(ht),
-                         std::ref(outputs[i]));
   }
-  for (auto& t : threads) {
-    t.join();
+  if (radix_passes <= 0) {
+    radix_passes =
+        (radix_bits + MAX_RADIX_BITS_PER_PASS - 1) / MAX_RADIX_BITS_PER_PASS;
   }
+  radix_passes = std::min(radix_passes, radix_bits);
+  auto pass_bits = [&](int pass) {
+    return radix_bits / radix_passes +
+           (pass < radix_bits % radix_passes ? 1 : 0);
+  };
+  // First-pass partitions are spread over the nodes in contiguous blocks;
+  // later passes only split them further, so they stay on the same node.
+  int num_nodes =
+      options.numa_aware && radix_passes > 0 ? numa_num_nodes() : 1;
+  size_t top_fanout = radix_passes > 0 ? size_t{1} << pass_bits(0) : 1;
+  auto top_node = [&](size_t p) {
+    return static_cast<int>(p * num_nodes / top_fanout);
+  };
+
+  // Partition
+  PhaseTimer partition_timer(stats ? &stats->partition : nullptr, num_threads,
+                             options.perf_counters);
+  auto partition = [&](const Tuples& input, NumaRegion& buf0, NumaRegion& buf1,
+                       std::vector<size_t>& offsets) -> const Tuple* {
+    if (radix_passes == 0) {
+      offsets = {0, input.size()};
+      return input.data();
+    }
+    // Raw pages, so nothing is touched until the first scatter writes them.
+    buf0 = NumaRegion(input.size() * sizeof(Tuple));
+    if (radix_passes > 1) {
+      buf1 = NumaRegion(input.size() * sizeof(Tuple));
+    }
+    auto place = [&](const std::vector<size_t>& top_offsets) {
+      for (size_t p = 0; p + 1 < top_offsets.size(); ++p) {
+        size_t offset = top_offsets[p] * sizeof(Tuple);
+        size_t len = (top_offsets[p + 1] - top_offsets[p]) * sizeof(Tuple);
+        buf0.BindToNode(offset, len, top_node(p));
+        buf1.BindToNode(offset, len, top_node(p));
+      }
+    };
+    std::vector<size_t> next_offsets;
+    int shift = 0;
+    for (int pass = 0; pass < radix_passes; ++pass) {
+      int bits = pass_bits(pass);
+      auto* buf0_data = static_cast<Tuple*>(buf0.data());
+      auto* buf1_data = static_cast<Tuple*>(buf1.data());
+      if (pass == 0) {
+        std::function<void(const std::vector<size_t>&)> on_offsets;
+        if (num_nodes > 1) {
+          on_offsets = place;
+        }
+        radix_partition(input.data(), input.size(), buf0_data, shift, bits,
+                        num_threads, pool, offsets, on_offsets,
+                        partition_timer);
+      } else {
+        Tuple* src = (pass % 2 == 1) ? buf0_data : buf1_data;
+        Tuple* dst = (pass % 2 == 1) ? buf1_data : buf0_data;
+        radix_refine(src, dst, offsets, shift, bits, num_threads, pool,
+                     next_offsets, partition_timer);
+        offsets.swap(next_offsets);
+      }
+      shift += bits;
+    }
+    return static_cast<const Tuple*>((radix_passes % 2 == 1) ? buf0.data()
+                                                             : buf1.data());
+  };
+  NumaRegion r_buf0, r_buf1, s_buf0, s_buf1;
+  std::vector<size_t> r_offsets, s_offsets;
+  const Tuple* R_parts = partition(R, r_buf0, r_buf1, r_offsets);
+  const Tuple* S_parts = partition(S, s_buf0, s_buf1, s_offsets);
+  partition_timer.Finish(radix_passes > 0 ? R.size() + S.size() : 0);
+
+  PhaseTimer join_timer(stats ? &stats->probe : nullptr, num_threads,
+                        options.perf_counters);
+  // Join partition pairs; each pair is owned by exactly one thread. Every
+  // node has its own queue over its block of partitions; a thread drains
+  // its node's queue first, then helps the others.
+  size_t num_partitions = r_offsets.size() - 1;
+  size_t per_top = num_partitions / top_fanout;
+  std::vector<size_t> node_begin(num_nodes + 1, num_partitions);
+  for (size_t p = top_fanout; p-- > 0;) {
+    node_begin[top_node(p)] = p * per_top;
+  }
+  for (int n = num_nodes; n-- > 0;) {
+    node_begin[n] = std::min(node_begin[n], node_begin[n + 1]);
+  }
+  std::vector<std::atomic<size_t>> next_partition(num_nodes);
+  for (int n = 0; n < num_nodes; ++n) {
+    next_partition[n].store(node_begin[n]);
+  }
+  std::vector<size_t> local_tuples(num_threads, 0);
+  std::vector<size_t> remote_tuples(num_threads, 0);
+  std::vector<size_t> matches(num_threads, 0);
+  std::vector<std::vector<std::pair<int, int>>> outputs(num_threads);
+  run_parallel(pool, num_threads, [&](int i) {
+    int node = i % num_nodes;
+    // Undone when the task ends; pool workers keep their own pinning.
+    std::unique_ptr<NumaThreadBinding> binding;
+    if (num_nodes > 1) {
+      binding.reset(new NumaThreadBinding(node));
+    }
+    join_timer.ThreadStart(i);
+    std::vector<int> bucket, next;
+    for (int k = 0; k < num_nodes; ++k) {
+      int home = (node + k) % num_nodes;
+      size_t p;
+      while ((p = next_partition[home].fetch_add(1)) < node_begin[home + 1]) {
+        matches[i] += join_partition(
+            R_parts, r_offsets[p], r_offsets[p + 1], S_parts, s_offsets[p],
+            s_offsets[p + 1], radix_bits, bucket, next, outputs[i],
+            options.sink, i);
+        size_t tuples = (r_offsets[p + 1] - r_offsets[p]) +
+                        (s_offsets[p + 1] - s_offsets[p]);
+        (k == 0 ? local_tuples : remote_tuples)[i] += tuples;
+      }
+    }
+    flush_to_sink(options.sink, i, outputs[i], 0);
+    join_timer.ThreadDone(i, local_tuples[i] + remote_tuples[i]);
+  });
+  if (numa_stats != nullptr) {
+    numa_stats->local_tuples.assign(num_nodes, 0);
+    numa_stats->remote_tuples.assign(num_nodes, 0);
+    for (int i = 0; i < num_threads; ++i) {
+      numa_stats->local_tuples[i % num_nodes] += local_tuples[i];
+      numa_stats->remote_tuples[i % num_nodes] += remote_tuples[i];
+    }
+  }
+
+  join_timer.Finish();
 
   // Merge results
-  std::vector<std::pair<int, int>> final_output;
-  for (auto& out : outputs) {
-    final_output.insert(final_output.end(), out.begin(), out.end());
-  }
-#ifdef TIME_ENABLE
-  auto probe_end = std::chrono::high_resolution_clock::now();
-  auto probe_duration =
-      std::chrono::duration_cast<std::chrono::milliseconds>(probe_end - probe_start);
-  std::cout << "Probe time: " << probe_duration.count() << " ms\n";
-  std::cout << "Total time: "
-            << (duration + probe_duration).count() << " ms\n";
-  std::cout << "Match count: " << final_output.size() << "\n";
-#endif
+  auto final_output = merge_outputs(outputs, options);
+  if (stats != nullptr) {
+    for (size_t m : matches) {
+      stats->match_count += m;
+    }
+    stats->bytes_allocated =
+        r_buf0.size() + r_buf1.size() + s_buf0.size() + s_buf1.size() +
+        final_output.capacity() * sizeof(final_output[0]);
+    stats->total_ms = total_timer.ElapsedMs();
+  }
   return final_output;
 }
 
-}  // namespace hashjoin
\ No newline at end of file
+auto multi_threaded_hash_join(const std::vector<std::pair<int, int>>& R,
+                              const std::vector<std::pair<int, int>>& S,
+                              const JoinOptions& options)
+    -> std::vector<std::pair<int, int>> {
+  switch (options.join_type) {
+    case JoinType::kSemi:
+    case JoinType::kAnti:
+      return semi_anti_join(R, S, options);
+    case JoinType::kLeftOuter:
+    case JoinType::kRightOuter:
+      return outer_join(R, S, options);
+    case JoinType::kInner:
+    default:
+      break;
+  }
+  switch (options.algorithm) {
+    case JoinAlgorithm::kRadixPartitioned:
+      return radix_hash_join(R, S, options);
+    case JoinAlgorithm::kSortMerge:
+      return sort_merge_join(R, S, options);
+    case JoinAlgorithm::kGraceHashJoin:
+      return grace_hash_join(R, S, options);
+    case JoinAlgorithm::kLockFreeHashTable: {
+      ConcurrentHashTable ht(R.size());
+      ht.SetPrefetch(options.prefetch);
+      return shared_table_join(ht, R, S, options);
+    }
+    case JoinAlgorithm::kSharedHashTable:
+    default: {
+      if (options.skew_aware) {
+        return skew_aware_join(R, S, options);
+      }
+      HashTable ht(options.table_size, options.key_size, 0.01,
+                   options.huge_pages);
+      ht.SetPrefetch(options.prefetch);
+      ht.SetMaxLoadFactor(options.max_load_factor);
+      return shared_table_join(ht, R, S, options);
+    }
+  }
+}
+
+}  // namespace hashjoin
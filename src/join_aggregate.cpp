@@ -0,0 +1,256 @@
+#include "join_aggregate.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#include "hashjoin.h"
+#include "key_traits.h"
+#include "morsel_scheduler.h"
+
+namespace hashjoin {
+
+namespace {
+
+using Traits = KeyTraits<int>;
+
+// R pre-aggregated to one row per distinct key.
+struct BuildAggregate {
+  uint64_t count = 0;
+  int64_t sum = 0;
+};
+
+// One thread's share of a group.
+struct PartialAggregate {
+  uint64_t count = 0;
+  int64_t sum_r = 0;
+  int64_t sum_s = 0;
+};
+
+/**
+ * Open-addressing map from key to an aggregate, grown at half full. Callers
+ * pass the key's hash in; the map indexes with its top bits and callers
+ * partition on lower ones. Not thread-safe.
+ */
+template <typename Aggregate>
+class AggregateMap {
+ public:
+  AggregateMap() { slots_.resize(16); }
+
+  auto FindOrInsert(int key, uint64_t hash) -> Aggregate& {
+    if ((size_ + 1) * 2 > slots_.size()) {
+      grow();
+    }
+    auto& slot = slots_[findSlot(key, hash)];
+    if (!slot.used) {
+      slot.used = true;
+      slot.key = key;
+      ++size_;
+    }
+    return slot.agg;
+  }
+  auto Find(int key, uint64_t hash) const -> const Aggregate* {
+    const auto& slot = slots_[findSlot(key, hash)];
+    return slot.used ? &slot.agg : nullptr;
+  }
+  /**
+   * Calls `fn(key, agg)` for every key in the map.
+   */
+  template <typename Fn>
+  void ForEach(Fn&& fn) {
+    for (auto& slot : slots_) {
+      if (slot.used) {
+        fn(slot.key, slot.agg);
+      }
+    }
+  }
+
+  auto size() const -> size_t { return size_; }
+  auto size_in_bytes() const -> size_t { return slots_.size() * sizeof(Slot); }
+
+ private:
+  struct Slot {
+    int key;
+    bool used = false;
+    Aggregate agg;
+  };
+
+  auto findSlot(int key, uint64_t hash) const -> size_t {
+    size_t mask = slots_.size() - 1;
+    size_t i = static_cast<size_t>(hash >> shift_);
+    while (slots_[i].used && slots_[i].key != key) {
+      i = (i + 1) & mask;
+    }
+    return i;
+  }
+  void grow() {
+    std::vector<Slot> old(slots_.size() * 2);
+    old.swap(slots_);
+    --shift_;
+    for (const auto& slot : old) {
+      if (slot.used) {
+        slots_[findSlot(slot.key, Traits::hash(slot.key))] = slot;
+      }
+    }
+  }
+
+  std::vector<Slot> slots_;
+  size_t size_ = 0;
+  int shift_ = 60;  // 64 - log2(slots_.size())
+};
+
+/**
+ * Merges partition p of every thread's maps into one map per partition,
+ * with partitions spread over the threads. `add(into, from)` combines two
+ * aggregates of the same key.
+ */
+template <typename Aggregate, typename Add>
+auto merge_partitions(std::vector<std::vector<AggregateMap<Aggregate>>>& local,
+                      size_t num_partitions, ThreadPool* pool, int num_threads,
+                      Add&& add) -> std::vector<AggregateMap<Aggregate>> {
+  std::vector<AggregateMap<Aggregate>> merged(num_partitions);
+  run_parallel(pool, num_threads, [&](int i) {
+    for (size_t p = i; p < num_partitions; p += num_threads) {
+      merged[p] = std::move(local[0][p]);
+      for (size_t t = 1; t < local.size(); ++t) {
+        local[t][p].ForEach([&](int key, const Aggregate& agg) {
+          add(merged[p].FindOrInsert(key, Traits::hash(key)), agg);
+        });
+        local[t][p] = AggregateMap<Aggregate>();
+      }
+    }
+  });
+  return merged;
+}
+
+}  // namespace
+
+auto join_aggregate(const std::vector<std::pair<int, int>>& R,
+                    const std::vector<std::pair<int, int>>& S,
+                    const JoinOptions& options, GroupBy group_by)
+    -> std::vector<JoinAggregate> {
+  int num_threads = join_threads(options);
+  ThreadPool* pool = options.pool;
+  JoinStats* stats = options.stats;
+  if (stats != nullptr) {
+    *stats = JoinStats();
+  }
+  PhaseTimer total_timer(nullptr, 0);
+  size_t num_partitions = 1;
+  while (num_partitions < static_cast<size_t>(num_threads)) {
+    num_partitions <<= 1;
+  }
+  // Maps index with the top hash bits; partition on lower ones.
+  auto partition_of = [&](uint64_t hash) -> size_t {
+    return (hash >> 16) & (num_partitions - 1);
+  };
+
+  // Build: pre-aggregate R per key, then merge the threads' partitions.
+  PhaseTimer build_timer(stats ? &stats->build : nullptr, num_threads,
+                         options.perf_counters);
+  std::vector<std::vector<AggregateMap<BuildAggregate>>> local_r(
+      num_threads, std::vector<AggregateMap<BuildAggregate>>(num_partitions));
+  MorselScheduler build_sched(R.size(), num_threads);
+  run_parallel(pool, num_threads, [&](int i) {
+    build_timer.ThreadStart(i);
+    size_t begin, end, tuples = 0;
+    while (build_sched.Next(i, begin, end)) {
+      for (size_t row = begin; row < end; ++row) {
+        uint64_t hash = Traits::hash(R[row].first);
+        auto& agg =
+            local_r[i][partition_of(hash)].FindOrInsert(R[row].first, hash);
+        ++agg.count;
+        agg.sum += R[row].second;
+      }
+      tuples += end - begin;
+    }
+    build_timer.ThreadDone(i, tuples);
+  });
+  auto table = merge_partitions(
+      local_r, num_partitions, pool, num_threads,
+      [](BuildAggregate& into, const BuildAggregate& from) {
+        into.count += from.count;
+        into.sum += from.sum;
+      });
+  build_timer.Finish();
+
+  // Probe: fold every match into the thread's partial aggregates. Grouped
+  // partials are sparse maps partitioned like the table, so a thread only
+  // holds the keys its morsels matched.
+  PhaseTimer probe_timer(stats ? &stats->probe : nullptr, num_threads,
+                         options.perf_counters);
+  bool grouped = group_by == GroupBy::kJoinKey;
+  std::vector<PartialAggregate> totals(num_threads);
+  std::vector<std::vector<AggregateMap<PartialAggregate>>> partials(
+      grouped ? num_threads : 0,
+      std::vector<AggregateMap<PartialAggregate>>(num_partitions));
+  MorselScheduler probe_sched(S.size(), num_threads);
+  run_parallel(pool, num_threads, [&](int i) {
+    probe_timer.ThreadStart(i);
+    size_t begin, end, tuples = 0;
+    while (probe_sched.Next(i, begin, end)) {
+      for (size_t row = begin; row < end; ++row) {
+        int key = S[row].first;
+        uint64_t hash = Traits::hash(key);
+        size_t p = partition_of(hash);
+        const BuildAggregate* r = table[p].Find(key, hash);
+        if (r == nullptr) {
+          continue;
+        }
+        auto& agg =
+            grouped ? partials[i][p].FindOrInsert(key, hash) : totals[i];
+        agg.count += r->count;
+        agg.sum_r += r->sum;
+        agg.sum_s += static_cast<int64_t>(S[row].second) *
+                     static_cast<int64_t>(r->count);
+      }
+      tuples += end - begin;
+    }
+    probe_timer.ThreadDone(i, tuples);
+  });
+
+  std::vector<JoinAggregate> result;
+  size_t partial_bytes = 0;
+  if (grouped) {
+    for (const auto& maps : partials) {
+      for (const auto& map : maps) {
+        partial_bytes += map.size_in_bytes();
+      }
+    }
+    // Only the keys some thread matched are merged.
+    auto merged = merge_partitions(
+        partials, num_partitions, pool, num_threads,
+        [](PartialAggregate& into, const PartialAggregate& from) {
+          into.count += from.count;
+          into.sum_r += from.sum_r;
+          into.sum_s += from.sum_s;
+        });
+    for (auto& map : merged) {
+      map.ForEach([&](int key, const PartialAggregate& agg) {
+        result.push_back({key, agg.count, agg.sum_r, agg.sum_s});
+      });
+    }
+  } else {
+    result.emplace_back();
+    for (const auto& total : totals) {
+      result[0].count += total.count;
+      result[0].sum_r += total.sum_r;
+      result[0].sum_s += total.sum_s;
+    }
+  }
+  probe_timer.Finish();
+
+  if (stats != nullptr) {
+    for (const auto& row : result) {
+      stats->match_count += row.count;
+    }
+    size_t bytes = result.capacity() * sizeof(result[0]);
+    for (const auto& map : table) {
+      bytes += map.size_in_bytes();
+    }
+    stats->bytes_allocated = bytes + partial_bytes;
+    stats->total_ms = total_timer.ElapsedMs();
+  }
+  return result;
+}
+
+}  // namespace hashjoin
@@ -0,0 +1,205 @@
+#include "join_variants.h"
+
+#include "hashjoin.h"
+#include "morsel_scheduler.h"
+
+namespace hashjoin {
+
+namespace {
+
+using Tuples = std::vector<std::pair<int, int>>;
+
+/**
+ * Merges the per-thread outputs and fills the fields of options.stats every
+ * variant shares.
+ */
+auto finish_join(std::vector<Tuples>& outputs,
+                 const std::vector<ProbeCounts>& counts,
+                 const std::vector<size_t>& matches, size_t table_bytes,
+                 const JoinOptions& options, const PhaseTimer& total_timer)
+    -> Tuples {
+  // Merge results
+  Tuples final_output = merge_outputs(outputs, options);
+  JoinStats* stats = options.stats;
+  if (stats != nullptr) {
+    ProbeCounts total;
+    for (size_t i = 0; i < outputs.size(); ++i) {
+      total += counts[i];
+      stats->match_count += matches[i];
+    }
+    record_probe_counts(stats, total);
+    stats->bytes_allocated =
+        table_bytes + final_output.capacity() * sizeof(final_output[0]);
+    stats->total_ms = total_timer.ElapsedMs();
+  }
+  return final_output;
+}
+
+}  // namespace
+
+auto semi_anti_join(const std::vector<std::pair<int, int>>& R,
+                    const std::vector<std::pair<int, int>>& S,
+                    const JoinOptions& options)
+    -> std::vector<std::pair<int, int>> {
+  int num_threads = join_threads(options);
+  ThreadPool* pool = options.pool;
+  JoinStats* stats = options.stats;
+  if (stats != nullptr) {
+    *stats = JoinStats();
+  }
+  PhaseTimer total_timer(nullptr, 0);
+  bool want_match = options.join_type == JoinType::kSemi;
+
+  // Build: keys only.
+  PhaseTimer build_timer(stats ? &stats->build : nullptr, num_threads,
+                         options.perf_counters);
+  ConcurrentKeySet keys(R.size());
+  MorselScheduler build_sched(R.size(), num_threads);
+  run_parallel(pool, num_threads, [&](int i) {
+    build_timer.ThreadStart(i);
+    size_t begin, end, tuples = 0;
+    while (build_sched.Next(i, begin, end)) {
+      for (size_t row = begin; row < end; ++row) {
+        keys.Insert(R[row].first);
+      }
+      tuples += end - begin;
+    }
+    build_timer.ThreadDone(i, tuples);
+  });
+  build_timer.Finish();
+
+  // Probe: a morsel's keys go through the vector kernel at once, which
+  // yields the matching rows as a selection vector.
+  PhaseTimer probe_timer(stats ? &stats->probe : nullptr, num_threads,
+                         options.perf_counters);
+  MorselScheduler probe_sched(S.size(), num_threads);
+  std::vector<Tuples> outputs(num_threads);
+  std::vector<ProbeCounts> counts(num_threads);
+  std::vector<size_t> matches(num_threads, 0);
+  run_parallel(pool, num_threads, [&](int i) {
+    probe_timer.ThreadStart(i);
+    std::vector<int> morsel_keys;
+    std::vector<uint32_t> sel;
+    size_t begin, end;
+    while (probe_sched.Next(i, begin, end)) {
+      morsel_keys.resize(end - begin);
+      sel.resize(end - begin);
+      for (size_t row = begin; row < end; ++row) {
+        morsel_keys[row - begin] = S[row].first;
+      }
+      size_t found =
+          keys.ContainsBatch(morsel_keys.data(), end - begin, sel.data());
+      if (want_match) {
+        for (size_t j = 0; j < found; ++j) {
+          emit_to_sink(options.sink, i, outputs[i], S[begin + sel[j]]);
+        }
+      } else {
+        // The rows between the hits.
+        size_t next = begin;
+        for (size_t j = 0; j < found; ++j) {
+          for (; next < begin + sel[j]; ++next) {
+            emit_to_sink(options.sink, i, outputs[i], S[next]);
+          }
+          next = begin + sel[j] + 1;
+        }
+        for (; next < end; ++next) {
+          emit_to_sink(options.sink, i, outputs[i], S[next]);
+        }
+      }
+      counts[i].probed += end - begin;
+      counts[i].passed += end - begin;
+      counts[i].found += found;
+      matches[i] += want_match ? found : end - begin - found;
+    }
+    flush_to_sink(options.sink, i, outputs[i], 0);
+    probe_timer.ThreadDone(i, counts[i].probed);
+  });
+  probe_timer.Finish();
+  return finish_join(outputs, counts, matches, keys.size_in_bytes(), options,
+                     total_timer);
+}
+
+auto outer_join(const std::vector<std::pair<int, int>>& R,
+                const std::vector<std::pair<int, int>>& S,
+                const JoinOptions& options)
+    -> std::vector<std::pair<int, int>> {
+  int num_threads = join_threads(options);
+  ThreadPool* pool = options.pool;
+  JoinStats* stats = options.stats;
+  if (stats != nullptr) {
+    *stats = JoinStats();
+  }
+  PhaseTimer total_timer(nullptr, 0);
+  bool keep_r = options.join_type == JoinType::kLeftOuter;
+
+  // Build
+  PhaseTimer build_timer(stats ? &stats->build : nullptr, num_threads,
+                         options.perf_counters);
+  HashTable ht(options.table_size, options.key_size, 0.01,
+               options.huge_pages);
+  ht.SetPrefetch(options.prefetch);
+  ht.SetMaxLoadFactor(options.max_load_factor);
+  MorselScheduler build_sched(R.size(), num_threads);
+  run_parallel(pool, num_threads, [&](int i) {
+    build_timer.ThreadStart(i);
+    size_t begin, end, tuples = 0;
+    while (build_sched.Next(i, begin, end)) {
+      build_thread(R, begin, end, ht);
+      tuples += end - begin;
+    }
+    ht.FinishRehash();
+    build_timer.ThreadDone(i, tuples);
+  });
+  build_timer.Finish();
+
+  // Probe; only a left outer join pays for flagging the entries it hits.
+  PhaseTimer probe_timer(stats ? &stats->probe : nullptr, num_threads,
+                         options.perf_counters);
+  MorselScheduler probe_sched(S.size(), num_threads);
+  std::vector<Tuples> outputs(num_threads);
+  std::vector<ProbeCounts> counts(num_threads);
+  std::vector<size_t> matches(num_threads, 0);
+  run_parallel(pool, num_threads, [&](int i) {
+    probe_timer.ThreadStart(i);
+    auto& out = outputs[i];
+    size_t begin, end;
+    while (probe_sched.Next(i, begin, end)) {
+      counts[i] += ht.ProbeOuter(
+          S.data() + begin, end - begin, keep_r,
+          [&](int value_r, int value_s) {
+            emit_to_sink(options.sink, i, out, {value_r, value_s});
+            ++matches[i];
+          },
+          [&](const std::pair<int, int>& kv) {
+            if (!keep_r) {
+              emit_to_sink(options.sink, i, out, {kNullValue, kv.second});
+              ++matches[i];
+            }
+          });
+    }
+    probe_timer.ThreadDone(i, counts[i].probed);
+  });
+
+  // Left outer: emit the R entries no probe flagged, a bucket range at a
+  // time.
+  MorselScheduler scan_sched(keep_r ? ht.num_buckets() : 0, num_threads);
+  run_parallel(pool, num_threads, [&](int i) {
+    auto& out = outputs[i];
+    size_t begin, end;
+    while (scan_sched.Next(i, begin, end)) {
+      ht.ForEachUnmatched(begin, end, [&](int value_r) {
+        emit_to_sink(options.sink, i, out, {value_r, kNullValue});
+        ++matches[i];
+      });
+    }
+    flush_to_sink(options.sink, i, out, 0);
+  });
+  probe_timer.Finish(S.size());
+  if (stats != nullptr) {
+    stats->chain_lengths = ht.ChainLengthHistogram();
+  }
+  return finish_join(outputs, counts, matches, ht.size_in_bytes(), options,
+                     total_timer);
+}
+
+}  // namespace hashjoin
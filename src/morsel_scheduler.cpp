@@ -0,0 +1,73 @@
+#include "morsel_scheduler.h"
+
+#include <algorithm>
+
+namespace hashjoin {
+
+namespace {
+
+inline auto pack(uint32_t head, uint32_t tail) -> uint64_t {
+  return (static_cast<uint64_t>(head) << 32) | tail;
+}
+
+}  // namespace
+
+MorselScheduler::MorselScheduler(size_t num_items, int num_workers,
+                                 size_t morsel_size)
+    : num_items_(num_items),
+      morsel_size_(std::max<size_t>(morsel_size, 1)),
+      num_workers_(std::max(num_workers, 1)),
+      deques_(new Deque[num_workers_]) {
+  size_t num_morsels = (num_items_ + morsel_size_ - 1) / morsel_size_;
+  for (int w = 0; w < num_workers_; ++w) {
+    auto head = static_cast<uint32_t>(num_morsels * w / num_workers_);
+    auto tail = static_cast<uint32_t>(num_morsels * (w + 1) / num_workers_);
+    deques_[w].range.store(pack(head, tail), std::memory_order_relaxed);
+  }
+}
+
+auto MorselScheduler::Next(int worker, size_t& begin, size_t& end) -> bool {
+  uint32_t morsel;
+  bool found = popFront(deques_[worker], morsel);
+  for (int i = 1; !found && i < num_workers_; ++i) {
+    found = popBack(deques_[(worker + i) % num_workers_], morsel);
+  }
+  if (!found) {
+    return false;
+  }
+  begin = morsel * morsel_size_;
+  end = std::min(num_items_, begin + morsel_size_);
+  return true;
+}
+
+auto MorselScheduler::popFront(Deque& deque, uint32_t& morsel) -> bool {
+  uint64_t range = deque.range.load(std::memory_order_relaxed);
+  while (true) {
+    auto head = static_cast<uint32_t>(range >> 32);
+    auto tail = static_cast<uint32_t>(range);
+    if (head >= tail) {
+      return false;
+    }
+    if (deque.range.compare_exchange_weak(range, pack(head + 1, tail))) {
+      morsel = head;
+      return true;
+    }
+  }
+}
+
+auto MorselScheduler::popBack(Deque& deque, uint32_t& morsel) -> bool {
+  uint64_t range = deque.range.load(std::memory_order_relaxed);
+  while (true) {
+    auto head = static_cast<uint32_t>(range >> 32);
+    auto tail = static_cast<uint32_t>(range);
+    if (head >= tail) {
+      return false;
+    }
+    if (deque.range.compare_exchange_weak(range, pack(head, tail - 1))) {
+      morsel = tail - 1;
+      return true;
+    }
+  }
+}
+
+}  // namespace hashjoin
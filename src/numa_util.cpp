@@ -0,0 +1,239 @@
+#include "numa_util.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#ifdef __linux__
+#include <dirent.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace hashjoin {
+
+namespace {
+
+struct Topology {
+  std::vector<int> node_ids;            // Kernel node id per logical node.
+  std::vector<std::vector<int>> cpus;   // Allowed CPUs per logical node.
+};
+
+// Parses a sysfs cpulist such as "0-3,8,10-11".
+auto parse_cpulist(const std::string& list) -> std::vector<int> {
+  std::vector<int> cpus;
+  std::stringstream ss(list);
+  std::string range;
+  while (std::getline(ss, range, ',')) {
+    if (range.empty() || range == "\n") {
+      continue;
+    }
+    size_t dash = range.find('-');
+    int first = std::atoi(range.c_str());
+    int last = dash == std::string::npos ? first
+                                         : std::atoi(range.c_str() + dash + 1);
+    for (int cpu = first; cpu <= last; ++cpu) {
+      cpus.push_back(cpu);
+    }
+  }
+  return cpus;
+}
+
+auto detect_topology() -> Topology {
+  Topology topo;
+#ifdef __linux__
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  bool have_mask = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+  if (DIR* dir = opendir("/sys/devices/system/node")) {
+    std::vector<int> ids;
+    while (dirent* entry = readdir(dir)) {
+      std::string name = entry->d_name;
+      if (name.size() > 4 && name.compare(0, 4, "node") == 0 &&
+          std::all_of(name.begin() + 4, name.end(), ::isdigit)) {
+        ids.push_back(std::atoi(name.c_str() + 4));
+      }
+    }
+    closedir(dir);
+    std::sort(ids.begin(), ids.end());
+    for (int id : ids) {
+      std::ifstream in("/sys/devices/system/node/node" + std::to_string(id) +
+                       "/cpulist");
+      std::string list;
+      std::getline(in, list);
+      std::vector<int> cpus;
+      for (int cpu : parse_cpulist(list)) {
+        if (!have_mask || (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed))) {
+          cpus.push_back(cpu);
+        }
+      }
+      if (!cpus.empty()) {
+        topo.node_ids.push_back(id);
+        topo.cpus.push_back(std::move(cpus));
+      }
+    }
+  }
+#endif
+  if (topo.node_ids.empty()) {
+    // Unknown topology: one node holding every CPU.
+    unsigned num_cpus = std::max(1u, std::thread::hardware_concurrency());
+    topo.node_ids.push_back(0);
+    topo.cpus.emplace_back();
+    for (unsigned cpu = 0; cpu < num_cpus; ++cpu) {
+      topo.cpus[0].push_back(static_cast<int>(cpu));
+    }
+  }
+  return topo;
+}
+
+auto topology() -> const Topology& {
+  static const Topology topo = detect_topology();
+  return topo;
+}
+
+}  // namespace
+
+auto numa_num_nodes() -> int {
+  return static_cast<int>(topology().node_ids.size());
+}
+
+auto numa_bind_thread(int node) -> bool {
+#ifdef __linux__
+  const auto& topo = topology();
+  if (node < 0 || node >= numa_num_nodes()) {
+    return false;
+  }
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  for (int cpu : topo.cpus[node]) {
+    if (cpu < CPU_SETSIZE) {
+      CPU_SET(cpu, &cpus);
+    }
+  }
+  return sched_setaffinity(0, sizeof(cpus), &cpus) == 0;
+#else
+  (void)node;
+  return false;
+#endif
+}
+
+//-----------NumaThreadBinding--------------
+NumaThreadBinding::NumaThreadBinding(int node) {
+#ifdef __linux__
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  if (sched_getaffinity(0, sizeof(cpus), &cpus) != 0) {
+    return;
+  }
+  for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+    if (CPU_ISSET(cpu, &cpus)) {
+      saved_cpus_.push_back(cpu);
+    }
+  }
+  bound_ = numa_bind_thread(node);
+#else
+  (void)node;
+#endif
+}
+
+NumaThreadBinding::~NumaThreadBinding() {
+#ifdef __linux__
+  if (!bound_) {
+    return;
+  }
+  cpu_set_t cpus;
+  CPU_ZERO(&cpus);
+  for (int cpu : saved_cpus_) {
+    CPU_SET(cpu, &cpus);
+  }
+  sched_setaffinity(0, sizeof(cpus), &cpus);
+#endif
+}
+
+//-----------NumaRegion--------------
+NumaRegion::NumaRegion(size_t bytes) : size_(bytes) {
+  if (bytes == 0) {
+    return;
+  }
+#ifdef __linux__
+  void* p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  data_ = p == MAP_FAILED ? nullptr : p;
+#else
+  data_ = std::malloc(bytes);
+#endif
+  if (data_ == nullptr) {
+    size_ = 0;
+    throw std::bad_alloc();
+  }
+}
+
+NumaRegion::~NumaRegion() { release(); }
+
+NumaRegion::NumaRegion(NumaRegion&& other) noexcept
+    : data_(std::exchange(other.data_, nullptr)),
+      size_(std::exchange(other.size_, 0)) {}
+
+auto NumaRegion::operator=(NumaRegion&& other) noexcept -> NumaRegion& {
+  if (this != &other) {
+    release();
+    data_ = std::exchange(other.data_, nullptr);
+    size_ = std::exchange(other.size_, 0);
+  }
+  return *this;
+}
+
+void NumaRegion::release() {
+  if (data_ != nullptr) {
+#ifdef __linux__
+    munmap(data_, size_);
+#else
+    std::free(data_);
+#endif
+    data_ = nullptr;
+    size_ = 0;
+  }
+}
+
+auto NumaRegion::BindToNode(size_t offset, size_t len, int node) -> bool {
+#if defined(__linux__) && defined(SYS_mbind)
+  const auto& topo = topology();
+  if (data_ == nullptr || node < 0 || node >= numa_num_nodes() ||
+      topo.node_ids[node] >= 64) {
+    return false;
+  }
+  auto page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  auto base = reinterpret_cast<uintptr_t>(data_);
+  uintptr_t begin = (base + offset + page - 1) / page * page;
+  uintptr_t end = (base + std::min(offset + len, size_)) / page * page;
+  if (begin >= end) {
+    return false;
+  }
+  unsigned long nodemask = 1UL << topo.node_ids[node];
+  const int kMpolBind = 2;
+  return syscall(SYS_mbind, begin, end - begin, kMpolBind, &nodemask,
+                 sizeof(nodemask) * 8 + 1, 0) == 0;
+#else
+  (void)offset;
+  (void)len;
+  (void)node;
+  return false;
+#endif
+}
+
+auto NumaRegion::AdviseHugePages() -> bool {
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+  return data_ != nullptr && madvise(data_, size_, MADV_HUGEPAGE) == 0;
+#else
+  return false;
+#endif
+}
+
+}  // namespace hashjoin
@@ -0,0 +1,133 @@
+#include "perf_counters.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstring>
+#endif
+
+namespace hashjoin {
+
+#ifdef __linux__
+namespace {
+
+struct EventSpec {
+  uint32_t type;
+  uint64_t config;
+};
+
+constexpr uint64_t cache_miss(uint64_t cache) {
+  return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+         (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+
+// Same order as the PerfCounts fields.
+const EventSpec kEvents[PerfCounters::kNumEvents] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HW_CACHE, cache_miss(PERF_COUNT_HW_CACHE_LL)},
+    {PERF_TYPE_HW_CACHE, cache_miss(PERF_COUNT_HW_CACHE_DTLB)},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+};
+
+auto open_event(const EventSpec& spec) -> int {
+  perf_event_attr attr;
+  std::memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = spec.type;
+  attr.config = spec.config;
+  attr.disabled = 1;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format =
+      PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  // pid 0, cpu -1: the calling thread on whatever CPU it runs.
+  return static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+auto read_scaled(int fd) -> uint64_t {
+  uint64_t values[3];  // value, time enabled, time running
+  if (read(fd, values, sizeof(values)) != sizeof(values) || values[2] == 0) {
+    return 0;
+  }
+  if (values[2] >= values[1]) {
+    return values[0];
+  }
+  return static_cast<uint64_t>(static_cast<double>(values[0]) * values[1] /
+                               values[2]);
+}
+
+}  // namespace
+
+PerfCounters::PerfCounters() {
+  for (int i = 0; i < kNumEvents; ++i) {
+    fds_[i] = open_event(kEvents[i]);
+  }
+}
+
+PerfCounters::~PerfCounters() {
+  for (int fd : fds_) {
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+}
+
+void PerfCounters::Start() {
+  for (int fd : fds_) {
+    if (fd >= 0) {
+      ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+      ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+}
+
+auto PerfCounters::Stop() -> PerfCounts {
+  uint64_t values[kNumEvents] = {};
+  for (int i = 0; i < kNumEvents; ++i) {
+    if (fds_[i] >= 0) {
+      ioctl(fds_[i], PERF_EVENT_IOC_DISABLE, 0);
+      values[i] = read_scaled(fds_[i]);
+    }
+  }
+  PerfCounts counts;
+  counts.cycles = values[0];
+  counts.instructions = values[1];
+  counts.llc_misses = values[2];
+  counts.dtlb_misses = values[3];
+  counts.branch_misses = values[4];
+  counts.available = available();
+  return counts;
+}
+
+auto PerfCounters::available() const -> bool {
+  for (int fd : fds_) {
+    if (fd >= 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+#else
+
+PerfCounters::PerfCounters() {
+  for (int& fd : fds_) {
+    fd = -1;
+  }
+}
+
+PerfCounters::~PerfCounters() = default;
+
+void PerfCounters::Start() {}
+
+auto PerfCounters::Stop() -> PerfCounts { return PerfCounts(); }
+
+auto PerfCounters::available() const -> bool { return false; }
+
+#endif
+
+}  // namespace hashjoin
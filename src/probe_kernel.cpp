@@ -0,0 +1,211 @@
+#include "probe_kernel.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+namespace hashjoin {
+
+namespace {
+
+void hash_keys_scalar(const int* keys, size_t n, int bits, uint32_t* out) {
+  for (size_t i = 0; i < n; ++i) {
+    out[i] = probe_hash(keys[i], bits);
+  }
+}
+
+auto find_keys_scalar(const int* slots, int bits, int empty, const int* keys,
+                      size_t begin, size_t n, uint32_t* sel,
+                      uint32_t* slot_of) -> size_t {
+  uint32_t mask = (1U << bits) - 1;
+  size_t count = 0;
+  for (size_t i = begin; i < n; ++i) {
+    int key = keys[i];
+    bool found = false;
+    uint32_t h = probe_hash(key, bits);
+    for (; key != empty; h = (h + 1) & mask) {
+      if (slots[h] == key) {
+        found = true;
+        break;
+      }
+      if (slots[h] == empty) {
+        break;
+      }
+    }
+    sel[count] = static_cast<uint32_t>(i);
+    if (slot_of != nullptr) {
+      slot_of[count] = h;
+    }
+    count += found;
+  }
+  return count;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2"))) void hash_keys_avx2(const int* keys, size_t n,
+                                                    int bits, uint32_t* out) {
+  const __m256i mult = _mm256_set1_epi32(static_cast<int>(kProbeHashMultiplier));
+  const __m128i shift = _mm_cvtsi32_si128(32 - bits);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256i k = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i));
+    __m256i h = _mm256_srl_epi32(_mm256_mullo_epi32(k, mult), shift);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), h);
+  }
+  hash_keys_scalar(keys + i, n - i, bits, out + i);
+}
+
+/**
+ * Eight keys per round: hash, gather their slots, compare. Lanes that hit
+ * or reach an empty slot retire; the rest step to the next slot and gather
+ * again until every lane is done. Hits are then written to `sel` without
+ * branches.
+ */
+__attribute__((target("avx2"))) auto find_keys_avx2(
+    const int* slots, int bits, int empty, const int* keys, size_t n,
+    uint32_t* sel, uint32_t* slot_of) -> size_t {
+  const __m256i mult = _mm256_set1_epi32(static_cast<int>(kProbeHashMultiplier));
+  const __m128i shift = _mm_cvtsi32_si128(32 - bits);
+  const __m256i mask = _mm256_set1_epi32(static_cast<int>((1U << bits) - 1));
+  const __m256i vempty = _mm256_set1_epi32(empty);
+  const __m256i one = _mm256_set1_epi32(1);
+  size_t count = 0;
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256i k = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(keys + i));
+    __m256i h = _mm256_srl_epi32(_mm256_mullo_epi32(k, mult), shift);
+    __m256i active = _mm256_xor_si256(_mm256_cmpeq_epi32(k, vempty),
+                                      _mm256_set1_epi32(-1));
+    __m256i found = _mm256_setzero_si256();
+    __m256i found_slots = _mm256_setzero_si256();
+    while (!_mm256_testz_si256(active, active)) {
+      __m256i s = _mm256_mask_i32gather_epi32(vempty, slots, h, active, 4);
+      __m256i hit = _mm256_and_si256(_mm256_cmpeq_epi32(s, k), active);
+      found = _mm256_or_si256(found, hit);
+      found_slots = _mm256_blendv_epi8(found_slots, h, hit);
+      active = _mm256_andnot_si256(
+          _mm256_or_si256(hit, _mm256_cmpeq_epi32(s, vempty)), active);
+      h = _mm256_and_si256(_mm256_add_epi32(h, one), mask);
+    }
+    auto bits_found = static_cast<unsigned>(
+        _mm256_movemask_ps(_mm256_castsi256_ps(found)));
+    if (slot_of != nullptr) {
+      alignas(32) uint32_t lane_slots[8];
+      _mm256_store_si256(reinterpret_cast<__m256i*>(lane_slots), found_slots);
+      for (unsigned j = 0; j < 8; ++j) {
+        sel[count] = static_cast<uint32_t>(i + j);
+        slot_of[count] = lane_slots[j];
+        count += (bits_found >> j) & 1;
+      }
+    } else {
+      for (unsigned j = 0; j < 8; ++j) {
+        sel[count] = static_cast<uint32_t>(i + j);
+        count += (bits_found >> j) & 1;
+      }
+    }
+  }
+  return count + find_keys_scalar(slots, bits, empty, keys, i, n, sel + count,
+                                  slot_of ? slot_of + count : nullptr);
+}
+
+__attribute__((target("avx512f"))) void hash_keys_avx512(const int* keys,
+                                                         size_t n, int bits,
+                                                         uint32_t* out) {
+  const __m512i mult = _mm512_set1_epi32(static_cast<int>(kProbeHashMultiplier));
+  const __m128i shift = _mm_cvtsi32_si128(32 - bits);
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m512i k = _mm512_loadu_si512(keys + i);
+    _mm512_storeu_si512(out + i,
+                        _mm512_srl_epi32(_mm512_mullo_epi32(k, mult), shift));
+  }
+  hash_keys_scalar(keys + i, n - i, bits, out + i);
+}
+
+/**
+ * find_keys_avx2 with 16 lanes, mask registers for the lane state and a
+ * compress-store for the hits.
+ */
+__attribute__((target("avx512f"))) auto find_keys_avx512(
+    const int* slots, int bits, int empty, const int* keys, size_t n,
+    uint32_t* sel, uint32_t* slot_of) -> size_t {
+  const __m512i mult = _mm512_set1_epi32(static_cast<int>(kProbeHashMultiplier));
+  const __m128i shift = _mm_cvtsi32_si128(32 - bits);
+  const __m512i mask = _mm512_set1_epi32(static_cast<int>((1U << bits) - 1));
+  const __m512i vempty = _mm512_set1_epi32(empty);
+  const __m512i one = _mm512_set1_epi32(1);
+  __m512i rows = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12,
+                                   13, 14, 15);
+  const __m512i sixteen = _mm512_set1_epi32(16);
+  size_t count = 0;
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m512i k = _mm512_loadu_si512(keys + i);
+    __m512i h = _mm512_srl_epi32(_mm512_mullo_epi32(k, mult), shift);
+    __mmask16 active = _mm512_cmpneq_epi32_mask(k, vempty);
+    __mmask16 found = 0;
+    __m512i found_slots = _mm512_setzero_si512();
+    while (active != 0) {
+      __m512i s = _mm512_mask_i32gather_epi32(vempty, active, h, slots, 4);
+      __mmask16 hit = _mm512_mask_cmpeq_epi32_mask(active, s, k);
+      found |= hit;
+      found_slots = _mm512_mask_mov_epi32(found_slots, hit, h);
+      active &= static_cast<__mmask16>(~hit) &
+                _mm512_cmpneq_epi32_mask(s, vempty);
+      h = _mm512_and_si512(_mm512_add_epi32(h, one), mask);
+    }
+    _mm512_mask_compressstoreu_epi32(sel + count, found, rows);
+    if (slot_of != nullptr) {
+      _mm512_mask_compressstoreu_epi32(slot_of + count, found, found_slots);
+    }
+    count += __builtin_popcount(found);
+    rows = _mm512_add_epi32(rows, sixteen);
+  }
+  return count + find_keys_scalar(slots, bits, empty, keys, i, n, sel + count,
+                                  slot_of ? slot_of + count : nullptr);
+}
+#endif
+
+}  // namespace
+
+auto simd_level() -> SimdLevel {
+#if defined(__x86_64__) || defined(__i386__)
+  static const SimdLevel level = __builtin_cpu_supports("avx512f")
+                                     ? SimdLevel::kAvx512
+                                     : __builtin_cpu_supports("avx2")
+                                           ? SimdLevel::kAvx2
+                                           : SimdLevel::kScalar;
+  return level;
+#else
+  return SimdLevel::kScalar;
+#endif
+}
+
+void hash_keys(const int* keys, size_t n, int bits, uint32_t* out,
+               SimdLevel level) {
+#if defined(__x86_64__) || defined(__i386__)
+  if (level == SimdLevel::kAvx512) {
+    return hash_keys_avx512(keys, n, bits, out);
+  }
+  if (level == SimdLevel::kAvx2) {
+    return hash_keys_avx2(keys, n, bits, out);
+  }
+#endif
+  hash_keys_scalar(keys, n, bits, out);
+}
+
+auto find_keys(const int* slots, int bits, int empty, const int* keys,
+               size_t n, uint32_t* sel, uint32_t* slot_of, SimdLevel level)
+    -> size_t {
+#if defined(__x86_64__) || defined(__i386__)
+  if (level == SimdLevel::kAvx512) {
+    return find_keys_avx512(slots, bits, empty, keys, n, sel, slot_of);
+  }
+  if (level == SimdLevel::kAvx2) {
+    return find_keys_avx2(slots, bits, empty, keys, n, sel, slot_of);
+  }
+#endif
+  return find_keys_scalar(slots, bits, empty, keys, 0, n, sel, slot_of);
+}
+
+}  // namespace hashjoin
@@ -0,0 +1,170 @@
+#include "relation_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+namespace hashjoin {
+
+namespace {
+
+constexpr uint64_t kColumnAlign = 64;
+
+auto align_up(uint64_t offset) -> uint64_t {
+  return (offset + kColumnAlign - 1) / kColumnAlign * kColumnAlign;
+}
+
+/**
+ * Owns a FILE* and throws on the first failed write.
+ */
+class FileWriter {
+ public:
+  explicit FileWriter(const char* path) : file_(std::fopen(path, "wb")) {
+    if (file_ == nullptr) {
+      throw std::system_error(errno, std::generic_category(),
+                              std::string("cannot open ") + path);
+    }
+  }
+  ~FileWriter() {
+    if (file_ != nullptr) {
+      std::fclose(file_);
+    }
+  }
+
+  void Write(const void* data, size_t bytes) {
+    if (bytes != 0 && std::fwrite(data, 1, bytes, file_) != bytes) {
+      fail();
+    }
+    offset_ += bytes;
+  }
+  void PadTo(uint64_t offset) {
+    static const char zeros[kColumnAlign] = {};
+    Write(zeros, offset - offset_);
+  }
+  void Close() {
+    std::FILE* file = file_;
+    file_ = nullptr;
+    if (std::fclose(file) != 0) {
+      fail();
+    }
+  }
+
+ private:
+  [[noreturn]] void fail() {
+    throw std::system_error(errno, std::generic_category(),
+                            "cannot write relation file");
+  }
+
+  std::FILE* file_;
+  uint64_t offset_ = 0;
+};
+
+}  // namespace
+
+void write_relation_file(const char* path, const ColumnarRelation& rel) {
+  RelationFileHeader header{};
+  std::memcpy(header.magic, RelationFileHeader::kMagic, sizeof(header.magic));
+  header.num_rows = rel.size;
+  header.key_offset = align_up(sizeof(header));
+  if (rel.payloads == nullptr) {
+    header.flags = RelationFileHeader::kNoPayloads;
+  } else {
+    header.payload_offset =
+        align_up(header.key_offset + rel.size * sizeof(int));
+  }
+
+  FileWriter out(path);
+  out.Write(&header, sizeof(header));
+  out.PadTo(header.key_offset);
+  out.Write(rel.keys, rel.size * sizeof(int));
+  if (rel.payloads != nullptr) {
+    out.PadTo(header.payload_offset);
+    out.Write(rel.payloads, rel.size * sizeof(int));
+  }
+  out.Close();
+}
+
+void write_relation_file(const char* path,
+                         const std::vector<std::pair<int, int>>& rel) {
+  std::vector<int> keys(rel.size());
+  std::vector<int> payloads(rel.size());
+  for (size_t i = 0; i < rel.size(); ++i) {
+    keys[i] = rel[i].first;
+    payloads[i] = rel[i].second;
+  }
+  write_relation_file(
+      path, ColumnarRelation{keys.data(), payloads.data(), rel.size()});
+}
+
+//-----------MappedRelation--------------
+MappedRelation::MappedRelation(const char* path) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    throw std::system_error(errno, std::generic_category(),
+                            std::string("cannot open ") + path);
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    int err = errno;
+    close(fd);
+    throw std::system_error(err, std::generic_category(), "cannot stat");
+  }
+  bytes_ = static_cast<size_t>(st.st_size);
+  if (bytes_ < sizeof(RelationFileHeader)) {
+    close(fd);
+    throw std::runtime_error(std::string(path) + ": not a relation file");
+  }
+  void* p = mmap(nullptr, bytes_, PROT_READ, MAP_PRIVATE, fd, 0);
+  int err = errno;
+  close(fd);
+  if (p == MAP_FAILED) {
+    throw std::system_error(err, std::generic_category(), "cannot mmap");
+  }
+  data_ = p;
+
+  const auto* base = static_cast<const char*>(data_);
+  const auto* header = reinterpret_cast<const RelationFileHeader*>(base);
+  bool has_payloads = (header->flags & RelationFileHeader::kNoPayloads) == 0;
+  uint64_t column_bytes = header->num_rows * sizeof(int);
+  auto fits = [&](uint64_t offset) {
+    return offset % kColumnAlign == 0 && offset >= sizeof(*header) &&
+           offset <= bytes_ && column_bytes <= bytes_ - offset;
+  };
+  if (std::memcmp(header->magic, RelationFileHeader::kMagic,
+                  sizeof(header->magic)) != 0 ||
+      header->num_rows > bytes_ || !fits(header->key_offset) ||
+      (has_payloads && !fits(header->payload_offset))) {
+    munmap(data_, bytes_);
+    data_ = nullptr;
+    throw std::runtime_error(std::string(path) + ": not a relation file");
+  }
+  rel_.keys = reinterpret_cast<const int*>(base + header->key_offset);
+  rel_.payloads = has_payloads ? reinterpret_cast<const int*>(
+                                     base + header->payload_offset)
+                               : nullptr;
+  rel_.size = static_cast<size_t>(header->num_rows);
+}
+
+MappedRelation::~MappedRelation() {
+  if (data_ != nullptr) {
+    munmap(data_, bytes_);
+  }
+}
+
+auto MappedRelation::ToPairs() const -> std::vector<std::pair<int, int>> {
+  std::vector<std::pair<int, int>> pairs(rel_.size);
+  for (size_t row = 0; row < rel_.size; ++row) {
+    pairs[row] = {rel_.keys[row], rel_.payload(row)};
+  }
+  return pairs;
+}
+
+}  // namespace hashjoin
@@ -0,0 +1,207 @@
+#include "skew_join.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <unordered_map>
+
+#include "flat_hash_table.h"
+#include "hashjoin.h"
+#include "morsel_scheduler.h"
+
+namespace hashjoin {
+
+namespace {
+
+using Tuple = std::pair<int, int>;
+using Tuples = std::vector<Tuple>;
+// Payload lists indexed by heavy key.
+using HeavyLists = std::vector<std::vector<int>>;
+
+constexpr uint32_t kNotHeavy = UINT32_MAX;
+
+/**
+ * Keys that show up at least SKEW_MIN_SAMPLE_HITS times in an evenly
+ * strided sample of R.
+ */
+auto sample_heavy_keys(const Tuples& R) -> std::vector<int> {
+  std::vector<int> heavy;
+  size_t samples = std::min<size_t>(SKEW_SAMPLE_SIZE, R.size());
+  if (samples == 0) {
+    return heavy;
+  }
+  std::unordered_map<int, size_t> hits;
+  for (size_t i = 0; i < samples; ++i) {
+    if (++hits[R[i * R.size() / samples].first] == SKEW_MIN_SAMPLE_HITS) {
+      heavy.push_back(R[i * R.size() / samples].first);
+    }
+  }
+  return heavy;
+}
+
+/**
+ * Appends every thread's list for each heavy key into one list per key.
+ */
+auto gather(std::vector<HeavyLists>& local, size_t num_heavy,
+            ThreadPool* pool, int num_threads) -> HeavyLists {
+  HeavyLists merged(num_heavy);
+  run_parallel(pool, num_threads, [&](int i) {
+    for (size_t h = i; h < num_heavy; h += num_threads) {
+      for (auto& lists : local) {
+        merged[h].insert(merged[h].end(), lists[h].begin(), lists[h].end());
+        std::vector<int>().swap(lists[h]);
+      }
+    }
+  });
+  return merged;
+}
+
+}  // namespace
+
+auto skew_aware_join(const std::vector<std::pair<int, int>>& R,
+                     const std::vector<std::pair<int, int>>& S,
+                     const JoinOptions& options)
+    -> std::vector<std::pair<int, int>> {
+  int num_threads = join_threads(options);
+  ThreadPool* pool = options.pool;
+  JoinStats* stats = options.stats;
+  if (stats != nullptr) {
+    *stats = JoinStats();
+  }
+  PhaseTimer total_timer(nullptr, 0);
+
+  std::vector<int> heavy_keys = sample_heavy_keys(R);
+  size_t num_heavy = heavy_keys.size();
+  BasicFlatHashTable<int, uint32_t> heavy_index(num_heavy);
+  for (size_t h = 0; h < num_heavy; ++h) {
+    heavy_index.Insert(heavy_keys[h], static_cast<uint32_t>(h));
+  }
+  auto heavy_of = [&](int key) -> uint32_t {
+    uint32_t h = kNotHeavy;
+    heavy_index.ForEachMatch(key, [&](uint32_t index) { h = index; });
+    return h;
+  };
+
+  // Build: heavy tuples go to thread-local lists, the rest to the table.
+  PhaseTimer build_timer(stats ? &stats->build : nullptr, num_threads,
+                         options.perf_counters);
+  HashTable ht(options.table_size, options.key_size, 0.01,
+               options.huge_pages);
+  ht.SetPrefetch(options.prefetch);
+  ht.SetMaxLoadFactor(options.max_load_factor);
+  std::vector<HeavyLists> local_r(num_threads, HeavyLists(num_heavy));
+  MorselScheduler build_sched(R.size(), num_threads);
+  run_parallel(pool, num_threads, [&](int i) {
+    build_timer.ThreadStart(i);
+    size_t begin, end, tuples = 0;
+    while (build_sched.Next(i, begin, end)) {
+      for (size_t row = begin; row < end; ++row) {
+        uint32_t h = num_heavy == 0 ? kNotHeavy : heavy_of(R[row].first);
+        if (h != kNotHeavy) {
+          local_r[i][h].push_back(R[row].second);
+        } else {
+          ht.Insert(R[row].first, R[row].second);
+        }
+      }
+      tuples += end - begin;
+    }
+    ht.FinishRehash();
+    build_timer.ThreadDone(i, tuples);
+  });
+  HeavyLists heavy_r = gather(local_r, num_heavy, pool, num_threads);
+  build_timer.Finish();
+
+  // Probe: heavy S tuples are set aside, the rest probe the table.
+  PhaseTimer probe_timer(stats ? &stats->probe : nullptr, num_threads,
+                         options.perf_counters);
+  std::vector<HeavyLists> local_s(num_threads, HeavyLists(num_heavy));
+  std::vector<Tuples> outputs(num_threads);
+  std::vector<ProbeCounts> counts(num_threads);
+  std::vector<size_t> matches(num_threads, 0);
+  MorselScheduler probe_sched(S.size(), num_threads);
+  run_parallel(pool, num_threads, [&](int i) {
+    probe_timer.ThreadStart(i);
+    Tuples normal;
+    size_t begin, end;
+    while (probe_sched.Next(i, begin, end)) {
+      normal.clear();
+      for (size_t row = begin; row < end; ++row) {
+        uint32_t h = num_heavy == 0 ? kNotHeavy : heavy_of(S[row].first);
+        if (h != kNotHeavy) {
+          local_s[i][h].push_back(S[row].second);
+        } else {
+          normal.push_back(S[row]);
+        }
+      }
+      counts[i] += ht.ProbeBatch(
+          normal.data(), normal.size(), [&](int value_r, int value_s) {
+            emit_to_sink(options.sink, i, outputs[i], {value_r, value_s});
+            ++matches[i];
+          });
+    }
+    // The heavy stage below only shows in the phase's wall time.
+    probe_timer.ThreadDone(i, counts[i].probed);
+  });
+  HeavyLists heavy_s = gather(local_s, num_heavy, pool, num_threads);
+
+  // Heavy keys: cut each cross product into chunks of R payloads sized so
+  // that a chunk emits about a morsel of pairs.
+  struct Task {
+    uint32_t key;
+    size_t begin;
+    size_t end;
+  };
+  std::vector<Task> tasks;
+  for (size_t h = 0; h < num_heavy; ++h) {
+    if (heavy_s[h].empty()) {
+      continue;
+    }
+    size_t chunk = std::max<size_t>(1, MORSEL_SIZE / heavy_s[h].size());
+    for (size_t b = 0; b < heavy_r[h].size(); b += chunk) {
+      tasks.push_back({static_cast<uint32_t>(h), b,
+                       std::min(heavy_r[h].size(), b + chunk)});
+    }
+  }
+  MorselScheduler task_sched(tasks.size(), num_threads, 1);
+  run_parallel(pool, num_threads, [&](int i) {
+    size_t begin, end;
+    while (task_sched.Next(i, begin, end)) {
+      for (size_t t = begin; t < end; ++t) {
+        const auto& task = tasks[t];
+        for (size_t r = task.begin; r < task.end; ++r) {
+          int value_r = heavy_r[task.key][r];
+          for (int value_s : heavy_s[task.key]) {
+            emit_to_sink(options.sink, i, outputs[i], {value_r, value_s});
+          }
+        }
+        matches[i] += (task.end - task.begin) * heavy_s[task.key].size();
+      }
+    }
+    flush_to_sink(options.sink, i, outputs[i], 0);
+  });
+
+  probe_timer.Finish(S.size());
+
+  // Merge results
+  auto final_output = merge_outputs(outputs, options);
+  if (stats != nullptr) {
+    ProbeCounts total;
+    for (int i = 0; i < num_threads; ++i) {
+      total += counts[i];
+      stats->match_count += matches[i];
+    }
+    record_probe_counts(stats, total);
+    stats->heavy_hitters = num_heavy;
+    stats->chain_lengths = ht.ChainLengthHistogram();
+    size_t heavy_bytes = 0;
+    for (size_t h = 0; h < num_heavy; ++h) {
+      heavy_bytes += (heavy_r[h].capacity() + heavy_s[h].capacity()) *
+                     sizeof(int);
+    }
+    stats->bytes_allocated = ht.size_in_bytes() + heavy_bytes +
+                             final_output.capacity() * sizeof(final_output[0]);
+    stats->total_ms = total_timer.ElapsedMs();
+  }
+  return final_output;
+}
+
+}  // namespace hashjoin
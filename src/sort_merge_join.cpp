@@ -0,0 +1,245 @@
+#include "sort_merge_join.h"
+
+#include <algorithm>
+#include <cstdint>
+
+#include "config.h"  // NOLINT
+#include "join_stats.h"
+#include "result_sink.h"
+#include "thread_pool.h"
+
+namespace hashjoin {
+
+namespace {
+
+using Tuples = std::vector<std::pair<int, int>>;
+
+constexpr int kDigitBits = 8;
+constexpr size_t kFanout = size_t{1} << kDigitBits;
+
+// Flip the sign bit so signed keys order correctly as unsigned digits.
+inline auto sort_digit(int key, int shift) -> size_t {
+  return ((static_cast<uint32_t>(key) ^ 0x80000000u) >> shift) & (kFanout - 1);
+}
+
+auto key_less(const std::pair<int, int>& a, const std::pair<int, int>& b)
+    -> bool {
+  return a.first < b.first;
+}
+
+/**
+ * Merges R[r_begin, r_end) with S[s_begin, s_end), emitting the cross
+ * product of every run of equal keys. With a sink, `output` is handed to it
+ * every SINK_BATCH_SIZE pairs, inside a run too. Returns the number of
+ * matches.
+ */
+auto merge_range(const Tuples& R, size_t r_begin, size_t r_end,
+                 const Tuples& S, size_t s_begin, size_t s_end,
+                 Tuples& output, ResultSink* sink, int thread_id) -> size_t {
+  size_t matches = 0;
+  size_t i = r_begin;
+  size_t j = s_begin;
+  while (i < r_end && j < s_end) {
+    int key = R[i].first;
+    if (key < S[j].first) {
+      ++i;
+    } else if (key > S[j].first) {
+      ++j;
+    } else {
+      size_t i_end = i;
+      while (i_end < r_end && R[i_end].first == key) {
+        ++i_end;
+      }
+      size_t j_end = j;
+      while (j_end < s_end && S[j_end].first == key) {
+        ++j_end;
+      }
+      for (size_t a = i; a < i_end; ++a) {
+        for (size_t b = j; b < j_end; ++b) {
+          emit_to_sink(sink, thread_id, output, {R[a].second, S[b].second});
+        }
+      }
+      matches += (i_end - i) * (j_end - j);
+      i = i_end;
+      j = j_end;
+    }
+  }
+  return matches;
+}
+
+}  // namespace
+
+//-----------sort---------------
+
+void sort_by_key(std::vector<std::pair<int, int>>& rel, int num_threads,
+                 ThreadPool* pool, PhaseTimer* timer) {
+  if (std::is_sorted(rel.begin(), rel.end(), key_less)) {
+    return;
+  }
+  num_threads = std::max(num_threads, 1);
+  size_t N = rel.size();
+  size_t chunk = (N + num_threads - 1) / num_threads;
+  Tuples buf(N);
+  Tuples* src = &rel;
+  Tuples* dst = &buf;
+  std::vector<std::vector<size_t>> hist(num_threads,
+                                        std::vector<size_t>(kFanout));
+  for (int shift = 0; shift < 32; shift += kDigitBits) {
+    run_parallel(pool, num_threads, [&](int t) {
+      if (timer != nullptr) {
+        timer->ThreadStart(t);
+      }
+      std::fill(hist[t].begin(), hist[t].end(), 0);
+      size_t begin = std::min(N, t * chunk);
+      size_t end = std::min(N, begin + chunk);
+      for (size_t i = begin; i < end; ++i) {
+        ++hist[t][sort_digit((*src)[i].first, shift)];
+      }
+      if (timer != nullptr) {
+        timer->ThreadDone(t, 0);
+      }
+    });
+    // Digit-major, thread-minor prefix sum keeps the scatter stable.
+    size_t sum = 0;
+    bool single_digit = false;
+    for (size_t d = 0; d < kFanout; ++d) {
+      size_t digit_begin = sum;
+      for (int t = 0; t < num_threads; ++t) {
+        size_t count = hist[t][d];
+        hist[t][d] = sum;
+        sum += count;
+      }
+      single_digit |= (sum - digit_begin == N);
+    }
+    if (single_digit) {
+      continue;  // Every key has the same digit here, nothing moves.
+    }
+
+    run_parallel(pool, num_threads, [&](int t) {
+      if (timer != nullptr) {
+        timer->ThreadStart(t);
+      }
+      size_t begin = std::min(N, t * chunk);
+      size_t end = std::min(N, begin + chunk);
+      auto& cursor = hist[t];
+      for (size_t i = begin; i < end; ++i) {
+        const auto& kv = (*src)[i];
+        (*dst)[cursor[sort_digit(kv.first, shift)]++] = kv;
+      }
+      if (timer != nullptr) {
+        timer->ThreadDone(t, 0);
+      }
+    });
+    std::swap(src, dst);
+  }
+  if (src != &rel) {
+    rel.swap(buf);
+  }
+}
+
+//-----------merge---------------
+
+auto merge_join_sorted(const std::vector<std::pair<int, int>>& R,
+                       const std::vector<std::pair<int, int>>& S,
+                       int num_threads, ThreadPool* pool)
+    -> std::vector<std::pair<int, int>> {
+  JoinOptions options;
+  options.num_threads = num_threads;
+  options.pool = pool;
+  return merge_join_sorted(R, S, options);
+}
+
+auto merge_join_sorted(const std::vector<std::pair<int, int>>& R,
+                       const std::vector<std::pair<int, int>>& S,
+                       const JoinOptions& options)
+    -> std::vector<std::pair<int, int>> {
+  int num_threads = std::max(join_threads(options), 1);
+  ThreadPool* pool = options.pool;
+  JoinStats* stats = options.stats;
+  if (stats != nullptr) {
+    *stats = JoinStats();
+  }
+  PhaseTimer merge_timer(stats ? &stats->probe : nullptr, num_threads,
+                         options.perf_counters);
+  // Cut the key space at quantiles of the larger side; a cut is the first
+  // position of its key on both sides, so equal keys never straddle ranges.
+  const Tuples& larger = R.size() >= S.size() ? R : S;
+  std::vector<size_t> r_cuts(num_threads + 1), s_cuts(num_threads + 1);
+  r_cuts[0] = s_cuts[0] = 0;
+  r_cuts[num_threads] = R.size();
+  s_cuts[num_threads] = S.size();
+  for (int t = 1; t < num_threads; ++t) {
+    size_t q = larger.size() * t / num_threads;
+    if (q >= larger.size()) {
+      r_cuts[t] = R.size();
+      s_cuts[t] = S.size();
+      continue;
+    }
+    std::pair<int, int> cut{larger[q].first, 0};
+    r_cuts[t] = std::lower_bound(R.begin(), R.end(), cut, key_less) - R.begin();
+    s_cuts[t] = std::lower_bound(S.begin(), S.end(), cut, key_less) - S.begin();
+  }
+
+  std::vector<Tuples> outputs(num_threads);
+  std::vector<size_t> matches(num_threads, 0);
+  run_parallel(pool, num_threads, [&](int t) {
+    merge_timer.ThreadStart(t);
+    matches[t] = merge_range(R, r_cuts[t], r_cuts[t + 1], S, s_cuts[t],
+                             s_cuts[t + 1], outputs[t], options.sink, t);
+    flush_to_sink(options.sink, t, outputs[t], 0);
+    merge_timer.ThreadDone(t, (r_cuts[t + 1] - r_cuts[t]) +
+                                  (s_cuts[t + 1] - s_cuts[t]));
+  });
+
+  merge_timer.Finish();
+
+  // Merge results
+  auto final_output = merge_outputs(outputs, options);
+  if (stats != nullptr) {
+    for (size_t m : matches) {
+      stats->match_count += m;
+    }
+    stats->bytes_allocated = final_output.capacity() * sizeof(final_output[0]);
+    stats->total_ms = merge_timer.ElapsedMs();
+  }
+  return final_output;
+}
+
+auto sort_merge_join(const std::vector<std::pair<int, int>>& R,
+                     const std::vector<std::pair<int, int>>& S,
+                     int num_threads, ThreadPool* pool)
+    -> std::vector<std::pair<int, int>> {
+  JoinOptions options;
+  options.num_threads = num_threads;
+  options.pool = pool;
+  return sort_merge_join(R, S, options);
+}
+
+auto sort_merge_join(const std::vector<std::pair<int, int>>& R,
+                     const std::vector<std::pair<int, int>>& S,
+                     const JoinOptions& options)
+    -> std::vector<std::pair<int, int>> {
+  int num_threads = join_threads(options);
+  ThreadPool* pool = options.pool;
+  // Sort
+  PhaseStats sort_stats;
+  PhaseTimer sort_timer(options.stats ? &sort_stats : nullptr, num_threads,
+                        options.perf_counters);
+  Tuples R_sorted(R);
+  Tuples S_sorted(S);
+  sort_by_key(R_sorted, num_threads, pool, &sort_timer);
+  sort_by_key(S_sorted, num_threads, pool, &sort_timer);
+  sort_timer.Finish(R.size() + S.size());
+
+  // Merge join
+  auto final_output = merge_join_sorted(R_sorted, S_sorted, options);
+  if (options.stats != nullptr) {
+    options.stats->partition = sort_stats;
+    options.stats->bytes_allocated +=
+        (R_sorted.capacity() + S_sorted.capacity()) * sizeof(R_sorted[0]);
+    options.stats->total_ms = sort_timer.ElapsedMs();
+  }
+  return final_output;
+}
+
+}  // namespace hashjoin
@@ -0,0 +1,87 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace hashjoin {
+
+ThreadPool::ThreadPool(int num_threads, bool pin_threads) {
+  num_threads = std::max(num_threads, 1);
+  for (int i = 0; i < num_threads; ++i) {
+    workers_.emplace_back(&ThreadPool::workerLoop, this, i, pin_threads);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    stop_ = true;
+  }
+  wake_cv_.notify_all();
+  for (auto& t : workers_) {
+    t.join();
+  }
+}
+
+void ThreadPool::Run(int num_tasks, const std::function<void(int)>& task) {
+  std::lock_guard<std::mutex> run_lock(run_mtx_);
+  std::unique_lock<std::mutex> lock(mtx_);
+  task_ = &task;
+  num_tasks_ = num_tasks;
+  pending_ = size();
+  ++generation_;
+  wake_cv_.notify_all();
+  done_cv_.wait(lock, [this] { return pending_ == 0; });
+  task_ = nullptr;
+}
+
+void ThreadPool::workerLoop(int id, bool pin) {
+#ifdef __linux__
+  if (pin) {
+    unsigned num_cpus = std::max(1u, std::thread::hardware_concurrency());
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(id % num_cpus, &cpus);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+  }
+#endif
+  uint64_t seen = 0;
+  std::unique_lock<std::mutex> lock(mtx_);
+  while (true) {
+    wake_cv_.wait(lock, [&] { return stop_ || generation_ != seen; });
+    if (stop_) {
+      return;
+    }
+    seen = generation_;
+    const auto* task = task_;
+    int num_tasks = num_tasks_;
+    lock.unlock();
+    for (int i = id; i < num_tasks; i += size()) {
+      (*task)(i);
+    }
+    lock.lock();
+    if (--pending_ == 0) {
+      done_cv_.notify_one();
+    }
+  }
+}
+
+void run_parallel(ThreadPool* pool, int num_threads,
+                  const std::function<void(int)>& task) {
+  if (pool != nullptr) {
+    pool->Run(num_threads, task);
+    return;
+  }
+  std::vector<std::thread> threads;
+  for (int i = 0; i < num_threads; ++i) {
+    threads.emplace_back(task, i);
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+}
+
+}  // namespace hashjoin
@@ -1,8 +1,24 @@
+#include <sched.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <functional>
 #include <iostream>
+#include <mutex>
 #include <random>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "gtest/gtest.h"
+#include "concurrent_hash_table.h"
+#include "flat_hash_table.h"
+#include "morsel_scheduler.h"
+#include "result_sink.h"
+#include "thread_pool.h"
 #include "hashjoin.h"  // 假设你的 HashTable 定义在 hashjoin.h 中
 
 namespace hashjoin {
@@ -73,6 +89,1187 @@ TEST(HashJoinTest, MutiThreadTest) {
 //   std::cout << "Join result size: " << res.size() << "\n";
 }
 
+auto sorted(std::vector<std::pair<int, int>> v)
+    -> std::vector<std::pair<int, int>> {
+  std::sort(v.begin(), v.end());
+  return v;
+}
+
+TEST(HashJoinTest, RadixJoinMatchesSharedTable) {
+  auto r = generate_random_data(100000, 50000, value_range);
+  auto s = generate_random_data(200000, 50000, value_range);
+  auto expected =
+      sorted(multi_threaded_hash_join(r, s, num_threads, r.size() / 100 + 7));
+  ASSERT_FALSE(expected.empty());
+
+  JoinOptions options;
+  options.algorithm = JoinAlgorithm::kRadixPartitioned;
+  options.num_threads = num_threads;
+  EXPECT_EQ(sorted(multi_threaded_hash_join(r, s, options)), expected);
+  for (int passes : {1, 2, 3}) {
+    options.radix_bits = 9;
+    options.radix_passes = passes;
+    EXPECT_EQ(sorted(multi_threaded_hash_join(r, s, options)), expected)
+        << "passes = " << passes;
+  }
+}
+
+TEST(HashJoinTest, FlatHashTableMatchesHashTable) {
+  auto r = generate_random_data(100000, 20000, value_range);
+  auto s = generate_random_data(100000, 40000, value_range);
+  HashTable ht(r.size() / 100 + 7);
+  ht.Build(r);
+  auto expected = sorted(ht.Probe(s));
+  ASSERT_FALSE(expected.empty());
+
+  FlatHashTable bulk(16);
+  bulk.Build(r);
+  EXPECT_EQ(sorted(bulk.Probe(s)), expected);
+
+  FlatHashTable incremental(16);
+  for (auto& kv : r) {
+    incremental.Insert(kv.first, kv.second);
+  }
+  EXPECT_EQ(sorted(incremental.Probe(s)), expected);
+  EXPECT_EQ(incremental.size(), bulk.size());
+  EXPECT_LE(bulk.size() * 2, bulk.capacity());
+
+  for (int key : {r[0].first, r[1].first, -1}) {
+    auto got = bulk.Get(key);
+    auto want = ht.Get(key);
+    std::sort(got.begin(), got.end());
+    std::sort(want.begin(), want.end());
+    EXPECT_EQ(got, want);
+  }
+}
+
+TEST(HashJoinTest, LockFreeBuildStress) {
+  // Few distinct keys so many threads race on the same bucket heads.
+  auto r = generate_random_data(200000, 1000, value_range);
+  auto s = generate_random_data(5000, 2000, value_range);
+  HashTable single(r.size() / 100 + 7);
+  single.Build(r);
+  auto expected = sorted(single.Probe(s));
+
+  const int stress_threads = 16;
+  for (int round = 0; round < 5; ++round) {
+    ConcurrentHashTable ht(r.size());
+    std::vector<std::thread> threads;
+    int chunk = r.size() / stress_threads;
+    for (int i = 0; i < stress_threads; ++i) {
+      int end = (i == stress_threads - 1) ? r.size() : (i + 1) * chunk;
+      threads.emplace_back(
+          [&, i, end] { build_thread(r, i * chunk, end, ht); });
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+    ASSERT_EQ(ht.size(), r.size());
+    ASSERT_EQ(sorted(ht.Probe(s)), expected) << "round " << round;
+    for (int key = 1; key <= 1000; key += 37) {
+      auto got = ht.Get(key);
+      auto want = single.Get(key);
+      std::sort(got.begin(), got.end());
+      std::sort(want.begin(), want.end());
+      ASSERT_EQ(got, want) << "key " << key;
+    }
+  }
+
+  JoinOptions options;
+  options.algorithm = JoinAlgorithm::kLockFreeHashTable;
+  options.num_threads = stress_threads;
+  auto s_join = generate_random_data(r.size(), 100000, value_range);
+  EXPECT_EQ(sorted(multi_threaded_hash_join(r, s_join, options)),
+            sorted(single.Probe(s_join)));
+}
+
+TEST(HashJoinTest, ConcurrentHashTableRejectsInsertPastCapacity) {
+  ConcurrentHashTable ht(2);
+  ht.Insert(1, 10);
+  ht.Insert(2, 20);
+  EXPECT_THROW(ht.Insert(3, 30), std::length_error);
+  EXPECT_EQ(ht.size(), 2u);
+  EXPECT_EQ(ht.Get(1), std::vector<int>{10});
+  EXPECT_TRUE(ht.Get(3).empty());
+}
+
+TEST(HashJoinTest, ProbeKeysReportsFoundKeys) {
+  std::vector<std::pair<int, int>> r = {{1, 10}, {1, 11}, {2, 20}, {3, 30}};
+  HashTable ht(4);
+  ConcurrentHashTable concurrent(r.size());
+  ht.Build(r);
+  concurrent.Build(r);
+  std::vector<int> keys = {1, 4, 2, 5, 1};
+  auto check = [&](const auto& table) {
+    size_t pairs = 0;
+    auto counts = table.ProbeKeys(keys.data(), keys.size(),
+                                  [&](size_t, int) { ++pairs; });
+    EXPECT_EQ(counts.probed, keys.size());
+    EXPECT_EQ(counts.found, 3u);
+    EXPECT_LE(counts.found, counts.passed);
+    EXPECT_EQ(pairs, 5u);
+  };
+  check(ht);
+  check(concurrent);
+}
+
+TEST(HashJoinTest, ForEachMatchVisitsSameValuesAsGet) {
+  auto r = generate_random_data(50000, 5000, value_range);
+  HashTable ht(r.size() / 100 + 7);
+  FlatHashTable flat;
+  ConcurrentHashTable concurrent(r.size());
+  ht.Build(r);
+  flat.Build(r);
+  concurrent.Build(r);
+  auto visit_all = [](const auto& table, int key) {
+    std::vector<int> values;
+    table.ForEachMatch(key, [&](int value) { values.push_back(value); });
+    std::sort(values.begin(), values.end());
+    return values;
+  };
+  for (int key = 0; key <= 5001; key += 7) {
+    auto want = ht.Get(key);
+    std::sort(want.begin(), want.end());
+    EXPECT_EQ(visit_all(ht, key), want) << "key " << key;
+    EXPECT_EQ(visit_all(flat, key), want) << "key " << key;
+    EXPECT_EQ(visit_all(concurrent, key), want) << "key " << key;
+  }
+}
+
+TEST(HashJoinTest, BlockedBloomFilterConcurrentInsert) {
+  const int num_keys = 200000;
+  const double target_fpr = 0.01;
+  BlockedBloomFilter filter(num_keys, target_fpr);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < num_threads; ++t) {
+    threads.emplace_back([&, t] {
+      for (int key = t; key < num_keys; key += num_threads) {
+        filter.insert(key * 2);  // Even keys only.
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  std::vector<int> keys(2 * num_keys);
+  for (int i = 0; i < 2 * num_keys; ++i) {
+    keys[i] = i;
+  }
+  std::vector<uint32_t> sel(keys.size());
+  size_t hits = filter.contains_batch(keys.data(), keys.size(), sel.data());
+  size_t false_positives = 0;
+  size_t next = 0;
+  for (int key = 0; key < 2 * num_keys; ++key) {
+    bool in_batch = next < hits && sel[next] == static_cast<uint32_t>(key);
+    next += in_batch;
+    ASSERT_EQ(in_batch, filter.contains(key)) << "key " << key;
+    if (key % 2 == 0) {
+      ASSERT_TRUE(in_batch) << "false negative for " << key;
+    } else {
+      false_positives += in_batch;
+    }
+  }
+  EXPECT_EQ(next, hits);
+  EXPECT_LT(static_cast<double>(false_positives) / num_keys, 3 * target_fpr);
+}
+
+TEST(HashJoinTest, SortMergeJoinMatchesSharedTable) {
+  auto r = generate_random_data(100000, 50000, value_range);
+  auto s = generate_random_data(200000, 50000, value_range);
+  auto expected =
+      sorted(multi_threaded_hash_join(r, s, num_threads, r.size() / 100 + 7));
+
+  JoinOptions options;
+  options.algorithm = JoinAlgorithm::kSortMerge;
+  options.num_threads = num_threads;
+  EXPECT_EQ(sorted(multi_threaded_hash_join(r, s, options)), expected);
+
+  // Sorted inputs reused across joins, with negative keys in the mix.
+  for (auto& kv : r) {
+    kv.first -= 25000;
+  }
+  for (auto& kv : s) {
+    kv.first -= 25000;
+  }
+  auto shifted = sorted(
+      multi_threaded_hash_join(r, s, num_threads, r.size() / 100 + 7));
+  sort_by_key(r, num_threads);
+  sort_by_key(s, num_threads);
+  EXPECT_TRUE(std::is_sorted(r.begin(), r.end(), [](auto& a, auto& b) {
+    return a.first < b.first;
+  }));
+  EXPECT_EQ(sorted(merge_join_sorted(r, s, num_threads)), shifted);
+  EXPECT_EQ(sorted(merge_join_sorted(r, s, 1)), shifted);
+}
+
+TEST(HashJoinTest, MorselSchedulerCoversInputOnce) {
+  const size_t num_items = 1000003;
+  const int workers = 6;
+  std::vector<std::atomic<int>> seen(num_items);
+  MorselScheduler sched(num_items, workers, 1000);
+  std::vector<std::thread> threads;
+  // Only half the workers run, so the rest of the morsels must be stolen.
+  for (int w = 0; w < workers; w += 2) {
+    threads.emplace_back([&, w] {
+      size_t begin, end;
+      while (sched.Next(w, begin, end)) {
+        for (size_t i = begin; i < end; ++i) {
+          seen[i].fetch_add(1);
+        }
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  for (size_t i = 0; i < num_items; ++i) {
+    ASSERT_EQ(seen[i].load(), 1) << "item " << i;
+  }
+}
+
+TEST(HashJoinTest, SharedTableJoinWithSmallerProbeSide) {
+  // The probe side used to be split with R's stride, which overran S.
+  auto r = generate_random_data(200000, 50000, value_range);
+  auto s = generate_random_data(30000, 50000, value_range);
+  HashTable ht(r.size() / 100 + 7);
+  ht.Build(r);
+  auto expected = sorted(ht.Probe(s));
+  EXPECT_EQ(sorted(multi_threaded_hash_join(r, s, num_threads,
+                                            r.size() / 100 + 7)),
+            expected);
+  JoinOptions options;
+  options.algorithm = JoinAlgorithm::kLockFreeHashTable;
+  options.num_threads = num_threads;
+  EXPECT_EQ(sorted(multi_threaded_hash_join(r, s, options)), expected);
+}
+
+TEST(HashJoinTest, ThreadPoolReusedAcrossJoins) {
+  ThreadPool pool(4, /*pin_threads=*/true);
+  std::vector<std::atomic<int>> runs(10);
+  pool.Run(10, [&](int i) { runs[i].fetch_add(1); });
+  for (auto& r : runs) {
+    EXPECT_EQ(r.load(), 1);
+  }
+
+  auto r = generate_random_data(50000, 20000, value_range);
+  auto s = generate_random_data(50000, 20000, value_range);
+  auto expected =
+      sorted(multi_threaded_hash_join(r, s, num_threads, r.size() / 100 + 7));
+  JoinOptions options;
+  options.pool = &pool;
+  for (auto algorithm :
+       {JoinAlgorithm::kSharedHashTable, JoinAlgorithm::kLockFreeHashTable,
+        JoinAlgorithm::kRadixPartitioned, JoinAlgorithm::kSortMerge}) {
+    options.algorithm = algorithm;
+    for (int i = 0; i < 3; ++i) {
+      EXPECT_EQ(sorted(multi_threaded_hash_join(r, s, options)), expected);
+    }
+  }
+}
+
+TEST(HashJoinTest, NumaAwareRadixJoin) {
+  auto r = generate_random_data(100000, 50000, value_range);
+  auto s = generate_random_data(100000, 50000, value_range);
+  auto expected =
+      sorted(multi_threaded_hash_join(r, s, num_threads, r.size() / 100 + 7));
+
+  NumaStats stats;
+  JoinOptions options;
+  options.algorithm = JoinAlgorithm::kRadixPartitioned;
+  options.num_threads = num_threads;
+  options.numa_aware = true;
+  options.numa_stats = &stats;
+  for (int passes : {1, 2}) {
+    options.radix_bits = 8;
+    options.radix_passes = passes;
+    EXPECT_EQ(sorted(multi_threaded_hash_join(r, s, options)), expected);
+    ASSERT_EQ(stats.local_tuples.size(), static_cast<size_t>(numa_num_nodes()));
+    size_t total = 0;
+    for (int n = 0; n < numa_num_nodes(); ++n) {
+      total += stats.local_tuples[n] + stats.remote_tuples[n];
+    }
+    EXPECT_EQ(total, r.size() + s.size());
+    if (numa_num_nodes() == 1) {
+      EXPECT_EQ(stats.remote_tuples[0], 0u);
+    }
+  }
+
+  // Join threads bind to a node and then get their CPUs back, so a pinned
+  // pool stays pinned.
+  // Pinned on a thread of its own: threads inherit the mask, and later
+  // tests must keep every CPU.
+  std::thread([] {
+    cpu_set_t before, after;
+    CPU_ZERO(&before);
+    CPU_SET(0, &before);
+    ASSERT_EQ(sched_setaffinity(0, sizeof(before), &before), 0);
+    {
+      NumaThreadBinding binding(numa_num_nodes() - 1);
+    }
+    ASSERT_EQ(sched_getaffinity(0, sizeof(after), &after), 0);
+    EXPECT_TRUE(CPU_EQUAL(&before, &after));
+  }).join();
+  ThreadPool pool(2, true);
+  options.pool = &pool;
+  options.numa_stats = nullptr;
+  EXPECT_EQ(sorted(multi_threaded_hash_join(r, s, options)), expected);
+  std::vector<int> cpu_counts(2, 0);
+  run_parallel(&pool, 2, [&](int i) {
+    cpu_set_t cpus;
+    sched_getaffinity(0, sizeof(cpus), &cpus);
+    cpu_counts[i] = CPU_COUNT(&cpus);
+  });
+  EXPECT_EQ(cpu_counts, (std::vector<int>{1, 1}));
+}
+
+TEST(HashJoinTest, ResultSinkStreamsAllMatches) {
+  auto r = generate_random_data(50000, 5000, value_range);
+  auto s = generate_random_data(50000, 5000, value_range);
+  auto expected =
+      sorted(multi_threaded_hash_join(r, s, num_threads, r.size() / 100 + 7));
+
+  for (auto algorithm :
+       {JoinAlgorithm::kSharedHashTable, JoinAlgorithm::kLockFreeHashTable,
+        JoinAlgorithm::kRadixPartitioned, JoinAlgorithm::kSortMerge}) {
+    std::vector<std::vector<std::pair<int, int>>> per_thread(num_threads);
+    size_t max_chunk = 0;
+    std::mutex mtx;
+    FunctionSink sink([&](int thread_id, const std::pair<int, int>* pairs,
+                          size_t count) {
+      per_thread[thread_id].insert(per_thread[thread_id].end(), pairs,
+                                   pairs + count);
+      std::lock_guard<std::mutex> lock(mtx);
+      max_chunk = std::max(max_chunk, count);
+    });
+    JoinOptions options;
+    options.algorithm = algorithm;
+    options.num_threads = num_threads;
+    options.sink = &sink;
+    EXPECT_TRUE(multi_threaded_hash_join(r, s, options).empty());
+
+    std::vector<std::pair<int, int>> streamed;
+    for (auto& out : per_thread) {
+      streamed.insert(streamed.end(), out.begin(), out.end());
+    }
+    EXPECT_EQ(sorted(streamed), expected);
+    // Chunks stay bounded instead of growing with the result.
+    EXPECT_LT(max_chunk, expected.size() / 2);
+
+    CountingSink counter(num_threads);
+    options.sink = &counter;
+    multi_threaded_hash_join(r, s, options);
+    EXPECT_EQ(counter.count(), expected.size());
+  }
+}
+
+TEST(HashJoinTest, ResultSinkChunksStayBoundedUnderFanOut) {
+  // Four keys: every morsel, partition and key run yields a huge product.
+  std::vector<std::pair<int, int>> r, s;
+  for (int i = 0; i < 3000; ++i) {
+    r.push_back({i % 4, i});
+    s.push_back({i % 4, -i});
+  }
+  const size_t expected = 3000u * 3000u / 4;
+
+  auto check = [&](const JoinOptions& base, const char* what,
+                   const std::function<void(const JoinOptions&)>& join) {
+    size_t max_chunk = 0;
+    size_t total = 0;
+    std::mutex mtx;
+    FunctionSink sink(
+        [&](int, const std::pair<int, int>*, size_t count) {
+          std::lock_guard<std::mutex> lock(mtx);
+          max_chunk = std::max(max_chunk, count);
+          total += count;
+        });
+    JoinOptions options = base;
+    options.num_threads = num_threads;
+    options.sink = &sink;
+    join(options);
+    EXPECT_EQ(total, expected) << what;
+    EXPECT_EQ(max_chunk, size_t{SINK_BATCH_SIZE}) << what;
+  };
+  auto run = [&](const JoinOptions& options) {
+    multi_threaded_hash_join(r, s, options);
+  };
+  JoinOptions options;
+  for (auto algorithm :
+       {JoinAlgorithm::kSharedHashTable, JoinAlgorithm::kLockFreeHashTable,
+        JoinAlgorithm::kRadixPartitioned, JoinAlgorithm::kSortMerge,
+        JoinAlgorithm::kGraceHashJoin}) {
+    options.algorithm = algorithm;
+    check(options, "algorithm", run);
+  }
+  options.algorithm = JoinAlgorithm::kSharedHashTable;
+  options.skew_aware = true;
+  check(options, "skew", run);
+  options.skew_aware = false;
+  options.join_type = JoinType::kLeftOuter;
+  check(options, "outer", run);
+  options.join_type = JoinType::kInner;
+  check(options, "columnar", [&](const JoinOptions& o) {
+    std::vector<int> r_keys, r_values, s_keys, s_values;
+    for (size_t i = 0; i < r.size(); ++i) {
+      r_keys.push_back(r[i].first);
+      r_values.push_back(r[i].second);
+      s_keys.push_back(s[i].first);
+      s_values.push_back(s[i].second);
+    }
+    multi_threaded_hash_join(
+        ColumnarRelation{r_keys.data(), r_values.data(), r.size()},
+        ColumnarRelation{s_keys.data(), s_values.data(), s.size()}, o);
+  });
+  FrozenHashTable frozen(r, options);
+  check(options, "frozen",
+        [&](const JoinOptions& o) { frozen.Probe(s, o); });
+}
+
+TEST(HashJoinTest, ColumnarJoinMatchesPairJoin) {
+  auto r = generate_random_data(50000, 20000, value_range);
+  auto s = generate_random_data(80000, 20000, value_range);
+  auto expected =
+      sorted(multi_threaded_hash_join(r, s, num_threads, r.size() / 100 + 7));
+
+  std::vector<int> r_keys, r_payloads, s_keys, s_payloads;
+  for (auto& kv : r) {
+    r_keys.push_back(kv.first);
+    r_payloads.push_back(kv.second);
+  }
+  for (auto& kv : s) {
+    s_keys.push_back(kv.first);
+    s_payloads.push_back(kv.second);
+  }
+  ColumnarRelation R{r_keys.data(), r_payloads.data(), r.size()};
+  ColumnarRelation S{s_keys.data(), s_payloads.data(), s.size()};
+  auto zip = [](const ColumnarResult& res) {
+    std::vector<std::pair<int, int>> pairs;
+    for (size_t i = 0; i < res.size(); ++i) {
+      pairs.push_back({res.r_values[i], res.s_values[i]});
+    }
+    return sorted(pairs);
+  };
+
+  HashTable ht(r.size() / 100 + 7);
+  ht.Build(R);
+  EXPECT_EQ(zip(ht.Probe(S)), expected);
+
+  JoinOptions options;
+  options.num_threads = num_threads;
+  for (auto algorithm :
+       {JoinAlgorithm::kSharedHashTable, JoinAlgorithm::kLockFreeHashTable,
+        JoinAlgorithm::kRadixPartitioned}) {
+    options.algorithm = algorithm;
+    EXPECT_EQ(zip(multi_threaded_hash_join(R, S, options)), expected);
+  }
+
+  // Without payload columns the result is row-id pairs.
+  options.algorithm = JoinAlgorithm::kLockFreeHashTable;
+  ColumnarRelation r_ids{r_keys.data(), nullptr, r.size()};
+  ColumnarRelation s_ids{s_keys.data(), nullptr, s.size()};
+  auto ids = multi_threaded_hash_join(r_ids, s_ids, options);
+  ASSERT_EQ(ids.size(), expected.size());
+  for (size_t i = 0; i < ids.size(); ++i) {
+    ASSERT_EQ(r_keys[ids.r_values[i]], s_keys[ids.s_values[i]]);
+  }
+}
+
+TEST(HashJoinTest, TypedJoinWideAndCompositeKeys) {
+  auto r = generate_random_data(50000, 20000, value_range);
+  auto s = generate_random_data(80000, 20000, value_range);
+  auto expected =
+      sorted(multi_threaded_hash_join(r, s, num_threads, r.size() / 100 + 7));
+
+  // The same keys spread over 64 bits; narrowing them would collide.
+  auto widen = [](const std::vector<std::pair<int, int>>& rel) {
+    std::vector<std::pair<int64_t, int>> wide;
+    for (auto& kv : rel) {
+      wide.push_back({(int64_t{kv.first} << 33) | kv.first, kv.second});
+    }
+    return wide;
+  };
+  JoinOptions options;
+  options.num_threads = num_threads;
+  EXPECT_EQ(sorted(typed_hash_join(widen(r), widen(s), options)), expected);
+
+  using Composite = std::pair<int, int64_t>;
+  auto compose = [](const std::vector<std::pair<int, int>>& rel) {
+    std::vector<std::pair<Composite, int>> out;
+    for (auto& kv : rel) {
+      out.push_back({{kv.first % 97, int64_t{kv.first} * 3}, kv.second});
+    }
+    return out;
+  };
+  EXPECT_EQ(sorted(typed_hash_join(compose(r), compose(s), options)),
+            expected);
+
+  BasicFlatHashTable<int64_t, int64_t> table(4);
+  table.Insert(int64_t{1} << 40, int64_t{1} << 50);
+  table.Insert(int64_t{1} << 40, 7);
+  table.Insert(0, 3);
+  auto values = table.Get(int64_t{1} << 40);
+  std::sort(values.begin(), values.end());
+  EXPECT_EQ(values, (std::vector<int64_t>{7, int64_t{1} << 50}));
+  EXPECT_EQ(table.Get(0), std::vector<int64_t>{3});
+}
+
+TEST(HashJoinTest, GraceJoinSpillsUnderBudget) {
+  auto r = generate_random_data(50000, 20000, value_range);
+  auto s = generate_random_data(80000, 20000, value_range);
+  auto expected =
+      sorted(multi_threaded_hash_join(r, s, num_threads, r.size() / 100 + 7));
+
+  GraceStats stats;
+  JoinOptions options;
+  options.algorithm = JoinAlgorithm::kGraceHashJoin;
+  options.num_threads = num_threads;
+  options.grace_stats = &stats;
+  EXPECT_EQ(sorted(multi_threaded_hash_join(r, s, options)), expected);
+  EXPECT_EQ(stats.spilled_partitions, 0u);
+
+  // Room for about a tenth of R.
+  std::string dir = ::testing::TempDir();
+  options.memory_budget = 5000 * 64;
+  options.spill_dir = dir.c_str();
+  EXPECT_EQ(sorted(multi_threaded_hash_join(r, s, options)), expected);
+  EXPECT_GT(stats.spilled_partitions, 0u);
+  EXPECT_GT(stats.spilled_tuples, 0u);
+  // Tables and probe batches stay near the budget; the result goes to a
+  // sink so that it does not count.
+  JoinStats join_stats;
+  CountingSink sink(num_threads);
+  options.stats = &join_stats;
+  options.sink = &sink;
+  options.table_size = 1;
+  multi_threaded_hash_join(r, s, options);
+  EXPECT_EQ(sink.count(), expected.size());
+  EXPECT_LE(join_stats.bytes_allocated,
+            options.memory_budget +
+                SPILL_BUFFER_SIZE * sizeof(std::pair<int, int>));
+  options.stats = nullptr;
+  options.sink = nullptr;
+
+  // A single key cannot be split further and is joined in memory.
+  std::vector<std::pair<int, int>> heavy_r, heavy_s;
+  for (int i = 0; i < 3000; ++i) {
+    heavy_r.push_back({7, i});
+  }
+  heavy_s.push_back({7, -1});
+  heavy_s.push_back({8, -2});
+  options.memory_budget = 100 * 64;
+  options.spill_dir = nullptr;
+  auto heavy = multi_threaded_hash_join(heavy_r, heavy_s, options);
+  EXPECT_EQ(heavy.size(), heavy_r.size());
+}
+
+TEST(HashJoinTest, MappedRelationFileRoundTrip) {
+  auto r = generate_random_data(50000, 20000, value_range);
+  auto s = generate_random_data(80000, 20000, value_range);
+  auto expected =
+      sorted(multi_threaded_hash_join(r, s, num_threads, r.size() / 100 + 7));
+
+  std::string r_path = ::testing::TempDir() + "hashjoin_r.rel";
+  std::string s_path = ::testing::TempDir() + "hashjoin_s.rel";
+  write_relation_file(r_path.c_str(), r);
+  write_relation_file(s_path.c_str(), s);
+  {
+    MappedRelation mapped_r(r_path.c_str());
+    MappedRelation mapped_s(s_path.c_str());
+    ASSERT_EQ(mapped_r.size(), r.size());
+    EXPECT_EQ(mapped_r.ToPairs(), r);
+
+    JoinOptions options;
+    options.num_threads = num_threads;
+    auto result = multi_threaded_hash_join(mapped_r.relation(),
+                                           mapped_s.relation(), options);
+    std::vector<std::pair<int, int>> pairs;
+    for (size_t i = 0; i < result.size(); ++i) {
+      pairs.push_back({result.r_values[i], result.s_values[i]});
+    }
+    EXPECT_EQ(sorted(pairs), expected);
+  }
+
+  // Key-only files hand back row ids.
+  std::vector<int> keys = {3, 1, 4, 1, 5};
+  write_relation_file(r_path.c_str(),
+                      ColumnarRelation{keys.data(), nullptr, keys.size()});
+  {
+    MappedRelation mapped(r_path.c_str());
+    EXPECT_EQ(mapped.relation().payloads, nullptr);
+    EXPECT_EQ(mapped.ToPairs()[3], std::make_pair(1, 3));
+  }
+
+  // A truncated file is rejected.
+  ASSERT_EQ(truncate(s_path.c_str(), 100), 0);
+  EXPECT_THROW(MappedRelation(s_path.c_str()), std::runtime_error);
+  EXPECT_THROW(MappedRelation("/nonexistent/hashjoin.rel"), std::system_error);
+  std::remove(r_path.c_str());
+  std::remove(s_path.c_str());
+}
+
+TEST(HashJoinTest, JoinStatsAreFilled) {
+  auto r = generate_random_data(50000, 20000, value_range);
+  auto s = generate_random_data(80000, 40000, value_range);
+  size_t expected =
+      multi_threaded_hash_join(r, s, num_threads, r.size() / 100 + 7).size();
+
+  CountingSink sink;
+  JoinStats stats;
+  JoinOptions options;
+  options.num_threads = num_threads;
+  options.table_size = r.size() / 100 + 7;
+  options.key_size = r.size();
+  options.stats = &stats;
+  options.sink = &sink;
+  multi_threaded_hash_join(r, s, options);
+  EXPECT_EQ(stats.match_count, expected);
+  EXPECT_EQ(stats.build.tuples, r.size());
+  EXPECT_EQ(stats.probe.tuples, s.size());
+  ASSERT_EQ(stats.probe.thread_ms.size(), static_cast<size_t>(num_threads));
+  EXPECT_GE(stats.total_ms, stats.probe.wall_ms);
+  EXPECT_GT(stats.bytes_allocated, 0u);
+  size_t buckets = 0, keys = 0;
+  for (size_t i = 0; i < stats.chain_lengths.size(); ++i) {
+    buckets += stats.chain_lengths[i];
+    keys += i * stats.chain_lengths[i];
+  }
+  // Bucket counts are rounded up to a power of two, then doubled while the
+  // keys outgrow the load factor.
+  EXPECT_GE(buckets, options.table_size);
+  EXPECT_EQ(buckets & (buckets - 1), 0u);
+  EXPECT_LE(keys, r.size());
+  EXPECT_LE(keys, options.max_load_factor * buckets);
+#ifdef BLOOM_FILTER_ENABLE
+  EXPECT_EQ(stats.bloom_passed + stats.bloom_rejected, s.size());
+  EXPECT_GT(stats.bloom_rejected, 0u);
+  EXPECT_LT(stats.bloom_false_positive_rate, 0.1);
+#else
+  EXPECT_EQ(stats.bloom_passed, 0u);
+#endif
+
+  for (auto algorithm :
+       {JoinAlgorithm::kLockFreeHashTable, JoinAlgorithm::kRadixPartitioned,
+        JoinAlgorithm::kSortMerge, JoinAlgorithm::kGraceHashJoin}) {
+    options.algorithm = algorithm;
+    multi_threaded_hash_join(r, s, options);
+    EXPECT_EQ(stats.match_count, expected);
+  }
+  EXPECT_EQ(stats.partition.tuples, 0u);
+  options.algorithm = JoinAlgorithm::kSortMerge;
+  multi_threaded_hash_join(r, s, options);
+  EXPECT_EQ(stats.partition.tuples, r.size() + s.size());
+  EXPECT_EQ(stats.probe.tuples, r.size() + s.size());
+}
+
+TEST(HashJoinTest, PerfCountersPerPhase) {
+  auto r = generate_random_data(50000, 20000, value_range);
+  auto s = generate_random_data(80000, 20000, value_range);
+  auto expected =
+      sorted(multi_threaded_hash_join(r, s, num_threads, r.size() / 100 + 7));
+
+  JoinStats stats;
+  JoinOptions options;
+  options.num_threads = num_threads;
+  options.stats = &stats;
+  options.perf_counters = true;
+  EXPECT_EQ(sorted(multi_threaded_hash_join(r, s, options)), expected);
+  ASSERT_EQ(stats.probe.thread_counters.size(),
+            static_cast<size_t>(num_threads));
+  // Containers often deny perf_event_open; then everything reads zero.
+  if (stats.build.counters.available) {
+    EXPECT_GT(stats.build.counters.instructions, 0u);
+    EXPECT_GT(stats.probe.counters.cycles, 0u);
+  } else {
+    EXPECT_EQ(stats.probe.counters.cycles, 0u);
+    EXPECT_EQ(stats.probe.counters.instructions, 0u);
+  }
+  // Gathering the result is a phase of its own.
+  EXPECT_EQ(stats.merge.tuples, expected.size());
+  EXPECT_EQ(stats.merge.thread_counters.size(),
+            static_cast<size_t>(num_threads));
+
+  // The partition and sort phases run on every thread too.
+  for (auto algorithm :
+       {JoinAlgorithm::kRadixPartitioned, JoinAlgorithm::kSortMerge}) {
+    options.algorithm = algorithm;
+    options.radix_passes = 2;
+    EXPECT_EQ(sorted(multi_threaded_hash_join(r, s, options)), expected);
+    EXPECT_EQ(stats.partition.tuples, r.size() + s.size());
+    ASSERT_EQ(stats.partition.thread_counters.size(),
+              static_cast<size_t>(num_threads));
+    EXPECT_EQ(stats.partition.counters.available,
+              stats.probe.counters.available);
+    if (stats.partition.counters.available) {
+      EXPECT_GT(stats.partition.counters.instructions, 0u);
+      EXPECT_GT(stats.merge.counters.instructions, 0u);
+    }
+    EXPECT_EQ(stats.merge.tuples, expected.size());
+  }
+  options.algorithm = JoinAlgorithm::kSharedHashTable;
+
+  options.stats = nullptr;
+  EXPECT_EQ(sorted(multi_threaded_hash_join(r, s, options)), expected);
+}
+
+TEST(HashJoinTest, SkewAwareJoinSplitsHeavyHitters) {
+  // A third of R and S share one key, a few more keys are warm.
+  auto r = generate_random_data(30000, 20000, value_range);
+  auto s = generate_random_data(600, 20000, value_range);
+  for (size_t i = 0; i < r.size(); i += 3) {
+    r[i].first = 7;
+  }
+  for (size_t i = 0; i < s.size(); i += 3) {
+    s[i].first = 7;
+  }
+  for (size_t i = 1; i < r.size(); i += 50) {
+    r[i].first = 11 + static_cast<int>(i / 50 % 4);
+  }
+  auto expected =
+      sorted(multi_threaded_hash_join(r, s, num_threads, r.size() / 100 + 7));
+
+  JoinStats stats;
+  JoinOptions options;
+  options.num_threads = num_threads;
+  options.table_size = r.size() / 100 + 7;
+  options.skew_aware = true;
+  options.stats = &stats;
+  EXPECT_EQ(sorted(multi_threaded_hash_join(r, s, options)), expected);
+  EXPECT_GE(stats.heavy_hitters, 5u);
+  EXPECT_EQ(stats.match_count, expected.size());
+
+  CountingSink sink;
+  options.sink = &sink;
+  EXPECT_TRUE(multi_threaded_hash_join(r, s, options).empty());
+  EXPECT_EQ(sink.count(), expected.size());
+
+  // Without skew nothing is set aside.
+  options.sink = nullptr;
+  auto uniform_r = generate_random_data(20000, 20000, value_range);
+  EXPECT_EQ(sorted(multi_threaded_hash_join(uniform_r, s, options)),
+            sorted(multi_threaded_hash_join(uniform_r, s, num_threads)));
+  EXPECT_EQ(stats.heavy_hitters, 0u);
+}
+
+TEST(HashJoinTest, SemiAntiAndOuterJoins) {
+  auto r = generate_random_data(20000, 30000, value_range);
+  auto s = generate_random_data(40000, 30000, value_range);
+  // Keys stored in R that collide with the key set's empty marker.
+  r[0].first = kNullValue;
+  s[0].first = kNullValue;
+
+  std::unordered_map<int, std::vector<int>> r_values;
+  std::unordered_set<int> s_keys;
+  for (const auto& kv : r) {
+    r_values[kv.first].push_back(kv.second);
+  }
+  for (const auto& kv : s) {
+    s_keys.insert(kv.first);
+  }
+  auto inner = multi_threaded_hash_join(r, s, num_threads, r.size() / 4 + 7);
+  std::vector<std::pair<int, int>> semi, anti, left = inner, right = inner;
+  for (const auto& kv : s) {
+    (r_values.count(kv.first) ? semi : anti).push_back(kv);
+    if (!r_values.count(kv.first)) {
+      right.push_back({kNullValue, kv.second});
+    }
+  }
+  for (const auto& kv : r) {
+    if (!s_keys.count(kv.first)) {
+      left.push_back({kv.second, kNullValue});
+    }
+  }
+
+  JoinStats stats;
+  JoinOptions options;
+  options.num_threads = num_threads;
+  options.table_size = r.size() / 4 + 7;
+  options.stats = &stats;
+  const std::pair<JoinType, std::vector<std::pair<int, int>>*> cases[] = {
+      {JoinType::kSemi, &semi},
+      {JoinType::kAnti, &anti},
+      {JoinType::kLeftOuter, &left},
+      {JoinType::kRightOuter, &right},
+  };
+  for (const auto& c : cases) {
+    options.join_type = c.first;
+    auto expected = sorted(*c.second);
+    EXPECT_EQ(sorted(multi_threaded_hash_join(r, s, options)), expected);
+    EXPECT_EQ(stats.match_count, expected.size());
+    // Other algorithms fall back to the shared table.
+    JoinOptions radix = options;
+    radix.algorithm = JoinAlgorithm::kRadixPartitioned;
+    EXPECT_EQ(sorted(multi_threaded_hash_join(r, s, radix)), expected);
+
+    CountingSink sink;
+    options.sink = &sink;
+    EXPECT_TRUE(multi_threaded_hash_join(r, s, options).empty());
+    EXPECT_EQ(sink.count(), expected.size());
+    options.sink = nullptr;
+  }
+
+  // An empty R keeps every S tuple in an anti join and matches none.
+  options.join_type = JoinType::kAnti;
+  EXPECT_EQ(sorted(multi_threaded_hash_join({}, s, options)), sorted(s));
+  options.join_type = JoinType::kLeftOuter;
+  EXPECT_TRUE(multi_threaded_hash_join({}, s, options).empty());
+}
+
+TEST(HashJoinTest, FusedJoinAggregation) {
+  auto r = generate_random_data(20000, 5000, value_range);
+  auto s = generate_random_data(50000, 8000, value_range);
+  std::unordered_map<int, std::vector<int>> r_values;
+  for (const auto& kv : r) {
+    r_values[kv.first].push_back(kv.second);
+  }
+  // Reference aggregates from the materialized join.
+  JoinAggregate total;
+  std::unordered_map<int, JoinAggregate> groups;
+  for (const auto& kv : s) {
+    auto it = r_values.find(kv.first);
+    if (it == r_values.end()) {
+      continue;
+    }
+    auto& group = groups[kv.first];
+    group.key = kv.first;
+    for (int value_r : it->second) {
+      for (auto* agg : {&total, &group}) {
+        ++agg->count;
+        agg->sum_r += value_r;
+        agg->sum_s += kv.second;
+      }
+    }
+  }
+  ASSERT_EQ(total.count,
+            multi_threaded_hash_join(r, s, num_threads, r.size() / 4 + 7)
+                .size());
+
+  JoinStats stats;
+  JoinOptions options;
+  options.num_threads = num_threads;
+  options.stats = &stats;
+  auto result = join_aggregate(r, s, options);
+  ASSERT_EQ(result.size(), 1u);
+  EXPECT_EQ(result[0].count, total.count);
+  EXPECT_EQ(result[0].sum_r, total.sum_r);
+  EXPECT_EQ(result[0].sum_s, total.sum_s);
+  EXPECT_EQ(stats.match_count, total.count);
+
+  result = join_aggregate(r, s, options, GroupBy::kJoinKey);
+  ASSERT_EQ(result.size(), groups.size());
+  for (const auto& row : result) {
+    ASSERT_TRUE(groups.count(row.key)) << row.key;
+    const auto& group = groups[row.key];
+    EXPECT_EQ(row.count, group.count);
+    EXPECT_EQ(row.sum_r, group.sum_r);
+    EXPECT_EQ(row.sum_s, group.sum_s);
+  }
+
+  // No matches still gives the single ungrouped row.
+  result = join_aggregate({}, s, options);
+  ASSERT_EQ(result.size(), 1u);
+  EXPECT_EQ(result[0].count, 0u);
+  EXPECT_TRUE(join_aggregate({}, s, options, GroupBy::kJoinKey).empty());
+}
+
+TEST(HashJoinTest, PrefetchingProbeMatchesPlainProbe) {
+  // Chains of several keys per bucket and several payloads per key.
+  auto r = generate_random_data(50000, 20000, value_range);
+  auto s = generate_random_data(100000, 40000, value_range);
+  JoinOptions options;
+  options.num_threads = num_threads;
+  options.table_size = r.size() / 8 + 7;
+  for (auto algorithm :
+       {JoinAlgorithm::kSharedHashTable, JoinAlgorithm::kLockFreeHashTable}) {
+    options.algorithm = algorithm;
+    for (auto type : {JoinType::kInner, JoinType::kLeftOuter,
+                      JoinType::kRightOuter}) {
+      options.join_type = type;
+      options.prefetch = false;
+      auto expected = sorted(multi_threaded_hash_join(r, s, options));
+      options.prefetch = true;
+      EXPECT_EQ(sorted(multi_threaded_hash_join(r, s, options)), expected);
+    }
+  }
+
+  // Batches that end mid-group.
+  HashTable ht(101, r.size());
+  ht.Build(r);
+  auto tail = std::vector<std::pair<int, int>>(s.begin(), s.begin() + 37);
+  ht.SetPrefetch(false);
+  auto expected = sorted(ht.Probe(tail));
+  ht.SetPrefetch(true);
+  EXPECT_EQ(sorted(ht.Probe(tail)), expected);
+}
+
+TEST(HashJoinTest, VectorProbeKernelsMatchScalar) {
+  // A half-full linear-probing table with long runs of taken slots.
+  const int bits = 12;
+  const int empty = kNullValue;
+  std::vector<int> slots(size_t{1} << bits, empty);
+  auto r = generate_random_data(slots.size() / 2, 6000, value_range);
+  for (const auto& kv : r) {
+    uint32_t h = probe_hash(kv.first, bits);
+    while (slots[h] != empty && slots[h] != kv.first) {
+      h = (h + 1) & (slots.size() - 1);
+    }
+    slots[h] = kv.first;
+  }
+  // Odd length so every kernel runs its scalar tail; the marker is a key.
+  auto s = generate_random_data(1003, 12000, value_range);
+  std::vector<int> keys;
+  for (const auto& kv : s) {
+    keys.push_back(kv.first);
+  }
+  keys[5] = empty;
+  std::unordered_set<int> present(slots.begin(), slots.end());
+  present.erase(empty);
+  std::vector<uint32_t> expected;
+  for (size_t i = 0; i < keys.size(); ++i) {
+    if (present.count(keys[i])) {
+      expected.push_back(static_cast<uint32_t>(i));
+    }
+  }
+
+  for (auto level : {SimdLevel::kScalar, SimdLevel::kAvx2,
+                     SimdLevel::kAvx512}) {
+    if (level > simd_level()) {
+      continue;
+    }
+    std::vector<uint32_t> sel(keys.size()), slot_of(keys.size());
+    sel.resize(find_keys(slots.data(), bits, empty, keys.data(), keys.size(),
+                         sel.data(), slot_of.data(), level));
+    EXPECT_EQ(sel, expected) << static_cast<int>(level);
+    for (size_t j = 0; j < sel.size(); ++j) {
+      ASSERT_EQ(slots[slot_of[j]], keys[sel[j]]);
+    }
+    std::vector<uint32_t> hashes(keys.size());
+    hash_keys(keys.data(), keys.size(), bits, hashes.data(), level);
+    for (size_t i = 0; i < keys.size(); ++i) {
+      ASSERT_EQ(hashes[i], probe_hash(keys[i], bits));
+    }
+  }
+
+  // The key set answers the same through its batch lookup.
+  ConcurrentKeySet set(r.size());
+  for (const auto& kv : r) {
+    set.Insert(kv.first);
+  }
+  std::vector<uint32_t> sel(keys.size());
+  sel.resize(set.ContainsBatch(keys.data(), keys.size(), sel.data()));
+  EXPECT_EQ(sel, expected);
+}
+
+TEST(HashJoinTest, ArenaPoolGivesEachThreadItsArena) {
+  ArenaPool pool;
+  Arena* main_arena = &pool.Local();
+  EXPECT_EQ(&pool.Local(), main_arena);
+  Arena* other = nullptr;
+  std::thread([&] { other = &pool.Local(); }).join();
+  EXPECT_NE(other, main_arena);
+  // Another pool on this thread does not hand out the first one's arena.
+  ArenaPool second;
+  EXPECT_NE(&second.Local(), main_arena);
+  EXPECT_EQ(&pool.Local(), main_arena);
+
+  // The last array grows in place; an older one moves with its contents.
+  Arena& arena = *main_arena;
+  int* a = arena.AllocateArray<int>(2);
+  a[0] = 1;
+  a[1] = 2;
+  EXPECT_EQ(arena.GrowArray(a, 2, 4), a);
+  arena.AllocateArray<int>(1);
+  int* moved = arena.GrowArray(a, 4, 8);
+  EXPECT_NE(moved, a);
+  EXPECT_EQ(moved[0], 1);
+  EXPECT_EQ(moved[1], 2);
+  // Larger than a chunk.
+  auto* big = arena.AllocateArray<char>(ARENA_CHUNK_SIZE + 1);
+  big[ARENA_CHUNK_SIZE] = 1;
+  EXPECT_GE(pool.bytes_reserved(), 2u * ARENA_CHUNK_SIZE);
+  EXPECT_GE(pool.bytes_used(), ARENA_CHUNK_SIZE + 1u + 9 * sizeof(int));
+  EXPECT_LE(pool.bytes_used(), pool.bytes_reserved());
+
+  // A small arena starts small and doubles its chunks up to the cap.
+  Arena small(false, ARENA_MIN_CHUNK_SIZE);
+  small.AllocateArray<char>(1);
+  EXPECT_EQ(small.bytes_reserved(), size_t{ARENA_MIN_CHUNK_SIZE});
+  small.AllocateArray<char>(ARENA_MIN_CHUNK_SIZE);
+  EXPECT_EQ(small.bytes_reserved(), 3u * ARENA_MIN_CHUNK_SIZE);
+  EXPECT_EQ(small.bytes_used(), ARENA_MIN_CHUNK_SIZE + 1u);
+  HashTable table(16, 100);
+  table.Insert(1, 1);
+  EXPECT_LT(table.size_in_bytes(), size_t{ARENA_MIN_CHUNK_SIZE});
+
+  auto r = generate_random_data(50000, 20000, value_range);
+  auto s = generate_random_data(50000, 20000, value_range);
+  JoinOptions options;
+  options.num_threads = num_threads;
+  options.table_size = r.size() / 4 + 7;
+  auto expected = sorted(multi_threaded_hash_join(r, s, options));
+  options.huge_pages = true;
+  EXPECT_EQ(sorted(multi_threaded_hash_join(r, s, options)), expected);
+}
+
+TEST(HashJoinTest, FrozenTableProbedConcurrently) {
+  auto r = generate_random_data(50000, 20000, value_range);
+  auto s = generate_random_data(60000, 20000, value_range);
+  // The key that marks empty slots, with duplicates on both sides.
+  r.push_back({INT32_MIN, 7});
+  r.push_back({INT32_MIN, 8});
+  s.push_back({INT32_MIN, 9});
+  JoinOptions options;
+  options.num_threads = num_threads;
+  options.table_size = r.size() / 4 + 7;
+  JoinStats build_stats;
+  options.stats = &build_stats;
+  FrozenHashTable table(r, options);
+  options.stats = nullptr;
+  std::unordered_set<int> distinct;
+  for (auto& kv : r) {
+    distinct.insert(kv.first);
+  }
+  EXPECT_EQ(table.size(), r.size());
+  EXPECT_EQ(table.num_keys(), distinct.size());
+  EXPECT_EQ(build_stats.build.tuples, r.size());
+  std::vector<int> values;
+  table.ForEachMatch(INT32_MIN, [&](int value) { values.push_back(value); });
+  std::sort(values.begin(), values.end());
+  EXPECT_EQ(values, (std::vector<int>{7, 8}));
+
+  // Several batches of S probe the one table at once.
+  const int kBatches = 4;
+  size_t batch = s.size() / kBatches + 1;
+  std::vector<std::vector<std::pair<int, int>>> expected(kBatches);
+  std::vector<std::vector<std::pair<int, int>>> got(kBatches);
+  std::vector<std::thread> probers;
+  for (int b = 0; b < kBatches; ++b) {
+    std::vector<std::pair<int, int>> part(
+        s.begin() + std::min(s.size(), b * batch),
+        s.begin() + std::min(s.size(), (b + 1) * batch));
+    expected[b] = sorted(multi_threaded_hash_join(r, part, options));
+    probers.emplace_back([&, b, part] {
+      JoinOptions probe_options = options;
+      probe_options.num_threads = 2;
+      probe_options.prefetch = b % 2 == 0;
+      got[b] = sorted(table.Probe(part, probe_options));
+    });
+  }
+  for (auto& t : probers) {
+    t.join();
+  }
+  for (int b = 0; b < kBatches; ++b) {
+    EXPECT_EQ(got[b], expected[b]) << b;
+  }
+}
+
+TEST(HashJoinTest, HashTableGrowsWhileBeingFilled) {
+  auto r = generate_random_data(100000, 50000, value_range);
+  auto s = generate_random_data(50000, 60000, value_range);
+  HashTable fixed(r.size());
+  fixed.Build(r);
+  auto expected = sorted(fixed.Probe(s));
+
+  // R arrives in chunks; probes between them may find a rehash half done.
+  HashTable ht(16);
+  ht.SetMaxLoadFactor(1.0);
+  std::unordered_map<int, std::vector<int>> seen;
+  const size_t kChunk = 7919;
+  for (size_t begin = 0; begin < r.size(); begin += kChunk) {
+    size_t end = std::min(r.size(), begin + kChunk);
+    for (size_t i = begin; i < end; ++i) {
+      ht.Insert(r[i].first, r[i].second);
+      seen[r[i].first].push_back(r[i].second);
+    }
+    for (size_t i = 0; i < end; i += 97) {
+      auto got = ht.Get(r[i].first);
+      auto want = seen[r[i].first];
+      std::sort(got.begin(), got.end());
+      std::sort(want.begin(), want.end());
+      ASSERT_EQ(got, want) << r[i].first;
+    }
+    EXPECT_FALSE(ht.Contains(-1));
+  }
+  EXPECT_EQ(sorted(ht.Probe(s)), expected);
+  ht.FinishRehash();
+  EXPECT_EQ(sorted(ht.Probe(s)), expected);
+  auto histogram = ht.ChainLengthHistogram();
+  size_t keys = 0;
+  for (size_t i = 0; i < histogram.size(); ++i) {
+    keys += i * histogram[i];
+  }
+  EXPECT_EQ(keys, seen.size());
+  EXPECT_LE(keys, ht.num_buckets());
+  EXPECT_LT(histogram.size(), 16u);
+
+  // Concurrent inserts that race with the rehashes they start.
+  HashTable shared(16);
+  shared.SetMaxLoadFactor(1.0);
+  std::vector<std::thread> builders;
+  size_t share = r.size() / num_threads + 1;
+  for (int t = 0; t < num_threads; ++t) {
+    int begin = static_cast<int>(std::min(r.size(), t * share));
+    int end = static_cast<int>(std::min(r.size(), (t + 1) * share));
+    builders.emplace_back([&, begin, end] {
+      build_thread(r, begin, end, shared);
+      finish_build_thread(shared);
+    });
+  }
+  for (auto& t : builders) {
+    t.join();
+  }
+  EXPECT_EQ(sorted(shared.Probe(s)), expected);
+  EXPECT_LE(seen.size(), shared.num_buckets());
+
+  // Lookups that run while builder threads insert and rehash. Builder t
+  // inserts keys t, t + n, ... in order and publishes how many are in.
+  HashTable live(16);
+  live.SetMaxLoadFactor(1.0);
+  const int kKeys = 40000;
+  int num_builders = std::max(2, num_threads);
+  std::vector<std::atomic<int>> inserted(num_builders);
+  std::atomic<int> running(num_builders);
+  builders.clear();
+  for (int t = 0; t < num_builders; ++t) {
+    builders.emplace_back([&, t] {
+      for (int key = t; key < kKeys; key += num_builders) {
+        live.Insert(key, -key);
+        inserted[t].fetch_add(1, std::memory_order_release);
+      }
+      finish_build_thread(live);
+      running.fetch_sub(1);
+    });
+  }
+  std::atomic<size_t> failures(0);
+  std::vector<std::thread> probers;
+  for (int p = 0; p < 2; ++p) {
+    probers.emplace_back([&, p] {
+      std::mt19937 gen(p);
+      do {
+        int t = static_cast<int>(gen() % num_builders);
+        int n = inserted[t].load(std::memory_order_acquire);
+        if (n == 0) {
+          continue;
+        }
+        int key = t + static_cast<int>(gen() % n) * num_builders;
+        if (live.Get(key) != std::vector<int>{-key} || !live.Contains(key) ||
+            live.Contains(-1 - key)) {
+          failures.fetch_add(1);
+        }
+      } while (running.load() > 0);
+    });
+  }
+  for (auto& t : builders) {
+    t.join();
+  }
+  for (auto& t : probers) {
+    t.join();
+  }
+  EXPECT_EQ(failures.load(), 0u);
+  for (int key = 0; key < kKeys; key += 101) {
+    EXPECT_TRUE(live.Contains(key)) << key;
+  }
+}
+
 }  // namespace hashjoin
 
 int main(int argc, char **argv) {